@@ -5,20 +5,71 @@
 #pragma once
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
 #include <concepts>
+#include <cstddef>
+#include <functional>
 #include <iostream>
 #include <memory>
+#include <memory_resource>
+#include <new>
+#include <optional>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <typeindex>
+#include <utility>
 #include <vector>
+#include "Erased.hpp"
+#include "ModelPool.hpp"
+#include "Relocation.hpp"
+#include "RenderCache.hpp"
+#include "TypeId.hpp"
 
 template <typename T>
 constexpr T absolute(T value) {
   return (value < 0) ? -value : value;
 }
 
+// Size in bytes of the small buffer inside `Shape`. Models which fit are
+// constructed inline and never touch the heap. Define it before including this
+// header to tune it for your own shapes.
+#ifndef SHAPE_BUFFER_SIZE
+#define SHAPE_BUFFER_SIZE 32
+#endif
+
+// Where a `Shape` allocates the models of `T` which don't fit its small buffer,
+// unless it was given a memory resource. Specialize `ShapePoolFor` to recycle
+// the models of a type which is created and destroyed a lot:
+/*
+  template <>
+  inline constexpr ShapePool ShapePoolFor<Polygon> = ShapePool::ThreadLocal;
+*/
+enum class ShapePool {
+  // `new` and `delete`.
+  None,
+  // A freelist per type, shared by all threads.
+  Shared,
+  // A freelist per type and thread. Models may still be destroyed on any
+  // thread, their memory goes back to the thread which allocated it.
+  ThreadLocal,
+};
+
+template <class T>
+inline constexpr ShapePool ShapePoolFor = ShapePool::None;
+
+// Whether formatting a `Shape` of `T` goes through `RenderCache::Global()`.
+// Worth it for types whose raster is expensive to build but is the same for
+// the same parameters. The type must be `ShapeHashable`:
+/*
+  template <>
+  inline constexpr bool ShapeRenderCacheFor<Circle> = true;
+*/
+template <class T>
+inline constexpr bool ShapeRenderCacheFor = false;
+
 // Type Erasure Sample Code.
 //
 // Implementation of Klaus Iglberger's C++ Type Erasure Design Pattern.
@@ -52,6 +103,9 @@ constexpr T absolute(T value) {
 template <typename T>
 constexpr std::string Format(const T& shape) = delete;
 
+template <typename T>
+constexpr void FormatTo(std::string& out, const T& shape) = delete;
+
 template <typename T>
 constexpr int Calculate(const T& shape) = delete;
 
@@ -63,10 +117,15 @@ constexpr int Calculate(const T& shape) = delete;
 // errors.
 class Shape;
 class ShapeView;
+class ShapeStore;
+struct ShapeHandle;
 
 template <>
 constexpr std::string Format(const Shape& shape);
 
+template <>
+constexpr void FormatTo(std::string& out, const Shape& shape);
+
 template <>
 constexpr int Calculate(const Shape& shape);
 
@@ -74,9 +133,23 @@ constexpr int Calculate(const Shape& shape);
 template <>
 constexpr std::string Format(const ShapeView& shape);
 
+template <>
+constexpr void FormatTo(std::string& out, const ShapeView& shape);
+
 template <>
 constexpr int Calculate(const ShapeView& shape);
 
+class TableShape;
+
+template <>
+constexpr std::string Format(const TableShape& shape);
+
+template <>
+constexpr void FormatTo(std::string& out, const TableShape& shape);
+
+template <>
+constexpr int Calculate(const TableShape& shape);
+
 // #endif  // __clang__
 
 // Concepts to allow sfiae in static asserts
@@ -91,6 +164,38 @@ concept ShapeHasStaticFormat = requires(T t) {
   { Format(t) } -> std::same_as<std::string>;
 };
 
+// Appending variants of Format. They let the caller hand in the string to
+// format into, so a whole frame can be rendered into a single buffer.
+template <typename T>
+concept ShapeHasMemberFormatTo = requires(T t, std::string& out) {
+  { t.FormatTo(out) } -> std::same_as<void>;
+};
+
+template <typename T>
+concept ShapeHasStaticFormatTo = requires(T t, std::string& out) {
+  { FormatTo(out, t) } -> std::same_as<void>;
+};
+
+// A shape which always looks the same can hand out its glyph as a view of
+// static storage. Formatting it appends the glyph straight to the output, with
+// no string built in between.
+template <typename T>
+concept ShapeHasMemberGlyph = requires(T t) {
+  { t.Glyph() } -> std::same_as<std::string_view>;
+};
+
+template <typename T>
+concept ShapeHasStaticGlyph = requires(T t) {
+  { Glyph(t) } -> std::same_as<std::string_view>;
+};
+
+// A shape whose raster was baked at compile time for some of its parameters,
+// see `ShapeGlyphTable`. Empty for all other parameters.
+template <typename T>
+concept ShapeHasBakedGlyph = requires(T t) {
+  { BakedGlyph(t) } -> std::same_as<std::optional<std::string_view>>;
+};
+
 template <typename T>
 concept ShapeHasMemberCalculate = requires(T t) {
   { t.Calculate() } -> std::same_as<int>;
@@ -101,6 +206,42 @@ concept ShapeHasStaticCalculate = requires(T t) {
   { Calculate(t) } -> std::same_as<int>;
 };
 
+// Optional hooks. A shape which can be hashed, and compared with `==`, is a
+// value: equal shapes may be shared, see ShapeInterner.hpp.
+template <typename T>
+concept ShapeHasMemberHash = requires(T t) {
+  { t.Hash() } -> std::convertible_to<std::size_t>;
+};
+
+template <typename T>
+concept ShapeHasStaticHash = requires(T t) {
+  { Hash(t) } -> std::convertible_to<std::size_t>;
+};
+
+template <typename T>
+concept ShapeHashable = (ShapeHasMemberHash<T> || ShapeHasStaticHash<T>) &&
+                        std::equality_comparable<T>;
+
+// Appends a freshly formatted string to `out`. Into an empty `out` the string
+// is moved rather than copied.
+constexpr void ShapeAppend(std::string& out, std::string&& formatted) {
+  if (out.empty()) {
+    out = std::move(formatted);
+  } else {
+    out += formatted;
+  }
+}
+
+template <class T>
+  requires(ShapeHasMemberGlyph<T> || ShapeHasStaticGlyph<T>)
+constexpr std::string_view ShapeGlyph(const T& object) {
+  if constexpr (ShapeHasMemberGlyph<T>) {
+    return object.Glyph();
+  } else {
+    return Glyph(object);
+  }
+}
+
 template <class T>
 struct IndirectShape;
 
@@ -109,25 +250,56 @@ struct ShapeBaseCRTP {
   friend IndirectShape<T>;
   friend ShapeBaseCRTP<IndirectShape<T>>;
   friend Shape;
+  template <class U>
+  friend constexpr void ShapeFormatTo(std::string& out, const U& object);
+  template <class U>
+  friend constexpr int ShapeCalculate(const U& object);
+  // Carried by every object, used or not. `ShapeSideTable` keeps the same
+  // metadata apart, only for the shapes which have any.
   int sizex{0};
   int sizey{0};
 
+  // Appends the formatted `T` after the base's header.
+  static void FormatBodyTo(std::string& out, const T& object) {
+    if constexpr (ShapeHasMemberGlyph<T> || ShapeHasStaticGlyph<T>) {
+      out += ShapeGlyph(object);
+    } else if constexpr (ShapeHasMemberFormatTo<T>) {
+      object.FormatTo(out);
+    } else if constexpr (ShapeHasStaticFormatTo<T>) {
+      using ::FormatTo;
+      FormatTo(out, object);
+    } else if constexpr (ShapeHasMemberFormat<T>) {
+      out += object.Format();
+    } else if constexpr (ShapeHasStaticFormat<T>) {
+      using ::Format;
+      out += Format(object);
+    }
+  }
+
  public:
+  void ShapeBaseCRTP_FormatTo(std::string& out) const {
+    std::format_to(std::back_inserter(out), "[X:{}|Y:{}]\n", sizex, sizey);
+  }
+
   std::string ShapeBaseCRTP_Format() const {
-    return std::format("[X:{}|Y:{}]\n", sizex, sizey);
+    std::string out;
+    ShapeBaseCRTP_FormatTo(out);
+    return out;
   }
 
  protected:
+  template <class SelfT>
+  void FormatTo(this const SelfT& self, std::string& out) {
+    self.ShapeBaseCRTP_FormatTo(out);
+    FormatBodyTo(out, static_cast<const T&>(self));
+  };
+
   template <class SelfT>
   std::string Format(this const SelfT& self) {
-    if constexpr (ShapeHasMemberFormat<T>) {
-      return self.ShapeBaseCRTP_Format() + static_cast<const T&>(self).Format();
-    } else if constexpr (ShapeHasStaticFormat<T>) {
-      using ::Format;
-      return self.ShapeBaseCRTP_Format() + Format(static_cast<const T&>(self));
-    } else {
-      return self.ShapeBaseCRTP_Format();
-    }
+    std::string out;
+    self.ShapeBaseCRTP_FormatTo(out);
+    FormatBodyTo(out, static_cast<const T&>(self));
+    return out;
   };
 
   template <class SelfT>
@@ -155,17 +327,31 @@ struct ShapeBaseCRTP {
 template <class T>
 struct IndirectShape : public T, public ShapeBaseCRTP<IndirectShape<T>> {
   template <class SelfT>
-  std::string Format(this const SelfT& self) {
-    if constexpr (ShapeHasMemberFormat<T>) {
-      return static_cast<const T&>(self).Format();
+  void FormatTo(this const SelfT& self, std::string& out) {
+    if constexpr (ShapeHasMemberGlyph<T> || ShapeHasStaticGlyph<T>) {
+      out += ShapeGlyph(static_cast<const T&>(self));
+    } else if constexpr (ShapeHasMemberFormatTo<T>) {
+      static_cast<const T&>(self).FormatTo(out);
+    } else if constexpr (ShapeHasStaticFormatTo<T>) {
+      using ::FormatTo;
+      FormatTo(out, static_cast<const T&>(self));
+    } else if constexpr (ShapeHasMemberFormat<T>) {
+      ShapeAppend(out, static_cast<const T&>(self).Format());
     } else if constexpr (ShapeHasStaticFormat<T>) {
       using ::Format;
-      return Format(static_cast<const T&>(self));
+      ShapeAppend(out, Format(static_cast<const T&>(self)));
     } else {
-      return static_cast<const ShapeBaseCRTP<T>&>(self).Format();
+      static_cast<const ShapeBaseCRTP<T>&>(self).FormatTo(out);
     }
   };
 
+  template <class SelfT>
+  std::string Format(this const SelfT& self) {
+    std::string out;
+    self.FormatTo(out);
+    return out;
+  };
+
   template <class SelfT>
   constexpr int Calculate(this const SelfT& self) {
     if constexpr (ShapeHasMemberCalculate<T>) {
@@ -188,6 +374,295 @@ struct IndirectShape : public T, public ShapeBaseCRTP<IndirectShape<T>> {
   }
 };
 
+// Whether formatting a `T` yields nothing but its glyph. A `ShapeBaseCRTP`
+// puts its header in front of it.
+template <class T>
+inline constexpr bool ShapeIsGlyph =
+    (ShapeHasMemberGlyph<T> || ShapeHasStaticGlyph<T>) &&
+    !std::is_base_of_v<ShapeBaseCRTP<T>, T>;
+
+// Routes an erased operation to the implementation provided by `T`. Every
+// flavour of type erased shape below dispatches through these, so the lookup
+// order is the same no matter how the shape is stored.
+//
+// Formatting always appends into a caller provided string. A `T` which only
+// knows how to return a fresh string from `Format` still works, its result is
+// appended.
+template <class T>
+constexpr void ShapeFormatTo(std::string& out, const T& object) {
+  if constexpr (std::is_base_of_v<ShapeBaseCRTP<T>, T>) {
+    static_cast<const ShapeBaseCRTP<T>&>(object).FormatTo(out);
+  } else if constexpr (ShapeHasMemberGlyph<T> || ShapeHasStaticGlyph<T>) {
+    out += ShapeGlyph(object);
+  } else if constexpr (ShapeHasMemberFormatTo<T>) {
+    object.FormatTo(out);
+  } else if constexpr (ShapeHasStaticFormatTo<T>) {
+    using ::FormatTo;
+    FormatTo(out, object);
+  } else if constexpr (ShapeHasMemberFormat<T>) {
+    ShapeAppend(out, object.Format());
+  } else if constexpr (ShapeHasStaticFormat<T>) {
+    using ::Format;
+    ShapeAppend(out, Format(object));
+  } else {
+    static_assert(ShapeHasMemberFormat<T> || ShapeHasStaticFormat<T>,
+                  "No 'Format' method found for type 'T'.");
+  }
+}
+
+template <class T>
+constexpr std::string ShapeFormat(const T& object) {
+  std::string out;
+  ShapeFormatTo(out, object);
+  return out;
+}
+
+// Rasterizes `object` during compilation, into an array of exactly the size
+// of its raster. A `std::string` made during constant evaluation can't outlive
+// it, but its characters can be copied out.
+template <class T>
+consteval std::size_t ShapeRasterSize(const T& object) {
+  return ShapeFormat(object).size();
+}
+
+template <std::size_t N, class T>
+consteval std::array<char, N> ShapeRasterize(const T& object) {
+  const std::string raster = ShapeFormat(object);
+  std::array<char, N> table{};
+  std::copy(raster.begin(), raster.end(), table.begin());
+  return table;
+}
+
+// The raster of a `T{Parameter}`, baked into read only data.
+template <class T, auto Parameter>
+struct ShapeGlyphTable {
+  static constexpr std::array table =
+      ShapeRasterize<ShapeRasterSize(T{Parameter})>(T{Parameter});
+  static constexpr std::string_view glyph{table.data(), table.size()};
+};
+
+template <class T>
+constexpr int ShapeCalculate(const T& object) {
+  if constexpr (std::is_base_of_v<ShapeBaseCRTP<T>, T>) {
+    return static_cast<const ShapeBaseCRTP<T>&>(object).Calculate();
+  } else if constexpr (ShapeHasMemberCalculate<T>) {
+    return object.Calculate();
+  } else if constexpr (ShapeHasStaticCalculate<T>) {
+    using ::Calculate;
+    return Calculate(object);
+  } else {
+    static_assert(ShapeHasMemberCalculate<T> || ShapeHasStaticCalculate<T>,
+                  "No 'Calculate' method found for type 'T'.");
+  }
+}
+
+template <ShapeHashable T>
+constexpr std::size_t ShapeHash(const T& object) {
+  if constexpr (ShapeHasMemberHash<T>) {
+    return object.Hash();
+  } else {
+    return Hash(object);
+  }
+}
+
+// A type can be stored in a `Shape` if it provides both operations, in any of
+// the ways the dispatch above looks for them. Anything else, say a
+// `std::vector<Shape>` which slipped into a brace initializer, is then turned
+// away by overload resolution instead of failing deep inside a model.
+template <class T>
+concept ShapeErasable =
+    std::is_base_of_v<ShapeBaseCRTP<T>, T> ||
+    ((ShapeHasMemberGlyph<T> || ShapeHasStaticGlyph<T> ||
+      ShapeHasMemberFormatTo<T> || ShapeHasStaticFormatTo<T> ||
+      ShapeHasMemberFormat<T> || ShapeHasStaticFormat<T>) &&
+     (ShapeHasMemberCalculate<T> || ShapeHasStaticCalculate<T>));
+
+// `ShapeFormatTo`, served from a baked glyph or else from the render cache for
+// types which opt in. The cache is skipped during constant evaluation.
+template <class T>
+constexpr void ShapeFormatToCached(std::string& out, const T& object) {
+  if constexpr (ShapeHasBakedGlyph<T>) {
+    if (const std::optional<std::string_view> glyph = BakedGlyph(object)) {
+      out += *glyph;
+      return;
+    }
+  }
+  if constexpr (ShapeRenderCacheFor<T>) {
+    static_assert(ShapeHashable<T>, "Cached shapes need a Hash and ==.");
+    if !consteval {
+      RenderCache::Global().FormatTo(
+          out, object, ShapeHash(object),
+          [&object](std::string& raster) { ShapeFormatTo(raster, object); });
+      return;
+    }
+  }
+  ShapeFormatTo(out, object);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Shape Operations For Erased<Storage, Ops...> */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Formats like `Shape` does, so erased shapes also use the baked glyphs and
+// the render cache.
+struct FormatOp {
+  using Signature = void(std::string&);
+
+  template <class T>
+  static constexpr void call(const T& object, std::string& out) {
+    ShapeFormatToCached(out, object);
+  }
+};
+
+struct CalculateOp {
+  using Signature = int();
+
+  template <class T>
+  static constexpr int call(const T& object) {
+    return ShapeCalculate(object);
+  }
+};
+
+struct PrintOp {
+  using Signature = void(std::ostream&);
+
+  template <class T>
+  static void call(const T& object, std::ostream& os) {
+    os << object;
+  }
+};
+
+// `Shape` and `ShapeView` as instantiations of the generic erasure. Any other
+// policy can be picked per use without touching the operations, for instance
+// `Erased<SharedStorage, FormatOp, CalculateOp, PrintOp>` for large shapes
+// which are copied around a lot but never modified.
+using ErasedShape = Erased<SmallBufferStorage<SHAPE_BUFFER_SIZE>, FormatOp,
+                           CalculateOp, PrintOp>;
+using ErasedShapeView = Erased<ViewStorage, FormatOp, CalculateOp, PrintOp>;
+
+// Opt-in copy-on-write shape. Copying a scene between pipeline stages only bumps
+// reference counts, a model is cloned once a stage modifies it via `as<T>()`.
+using CowShape = Erased<CopyOnWriteStorage, FormatOp, CalculateOp, PrintOp>;
+
+static_assert(std::is_trivially_copyable_v<ErasedShapeView>);
+
+template <class Storage, class... Ops>
+  requires(std::same_as<Ops, FormatOp> || ...)
+constexpr void FormatTo(std::string& out, const Erased<Storage, Ops...>& shape) {
+  shape.template call<FormatOp>(out);
+}
+
+template <class Storage, class... Ops>
+  requires(std::same_as<Ops, FormatOp> || ...)
+constexpr std::string Format(const Erased<Storage, Ops...>& shape) {
+  std::string out;
+  shape.template call<FormatOp>(out);
+  return out;
+}
+
+template <class Storage, class... Ops>
+  requires(std::same_as<Ops, CalculateOp> || ...)
+constexpr int Calculate(const Erased<Storage, Ops...>& shape) {
+  return shape.template call<CalculateOp>();
+}
+
+template <class Storage, class... Ops>
+  requires(std::same_as<Ops, PrintOp> || ...)
+std::ostream& operator<<(std::ostream& os,
+                         const Erased<Storage, Ops...>& shape) {
+  shape.template call<PrintOp>(os);
+  return os;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Hand Rolled Dispatch Table */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// A manual replacement for the compiler generated vtable of `Shape::Model<T>`.
+// The handle points straight at a table of function pointers, instead of at an
+// object which points at its vtable, saving one indirection per call. Each
+// table is a `constexpr` object, so it ends up in read only data.
+//
+// The non-owning operations are all a `ShapeView` needs. Keeping them in a base
+// means a view never instantiates the copy and destruction of the viewed type.
+struct ShapeViewDispatch {
+  void (*FormatTo)(const void* object, std::string& out);
+  int (*Calculate)(const void* object);
+  void (*print)(const void* object, std::ostream& os);
+  // Compared by `is<T>()`. `type` is only kept for `typeidx()` and is null
+  // without RTTI.
+  TypeId id;
+  const std::type_info* type;
+};
+
+struct ShapeDispatch : ShapeViewDispatch {
+  // The Prototype Design Pattern
+  // Copies the object into `buffer` when it fits, otherwise onto the heap.
+  void* (*clone)(const void* object, std::byte* buffer);
+  // Moves an inline object into `buffer`. A heap object is returned as is.
+  void* (*move)(void* object, std::byte* buffer) noexcept;
+  void (*destroy)(void* object) noexcept;
+};
+
+template <class T>
+struct ShapeDispatchModel {
+  // Same rule as `Shape::IsInline`, minus the vtable pointer of the model.
+  static constexpr bool IsInline =
+      sizeof(T) <= SHAPE_BUFFER_SIZE &&
+      alignof(T) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<T>;
+
+  template <class... Args>
+  static void* Create(std::byte* buffer, Args&&... args) {
+    if constexpr (IsInline) {
+      return ::new (buffer) T(std::forward<Args>(args)...);
+    } else {
+      return new T(std::forward<Args>(args)...);
+    }
+  }
+
+  static constexpr void FormatTo(const void* object, std::string& out) {
+    ShapeFormatToCached(out, *static_cast<const T*>(object));
+  }
+
+  static constexpr int Calculate(const void* object) {
+    return ShapeCalculate(*static_cast<const T*>(object));
+  }
+
+  static void print(const void* object, std::ostream& os) {
+    os << *static_cast<const T*>(object);
+  }
+
+  static void* clone(const void* object, std::byte* buffer) {
+    if constexpr (std::is_copy_constructible_v<T>) {
+      return Create(buffer, *static_cast<const T*>(object));
+    } else {
+      ThrowCopyOfMoveOnly();
+    }
+  }
+
+  static void* move(void* object, std::byte* buffer) noexcept {
+    if constexpr (IsInline) {
+      void* moved = ::new (buffer) T(std::move(*static_cast<T*>(object)));
+      std::destroy_at(static_cast<T*>(object));
+      return moved;
+    } else {
+      return object;
+    }
+  }
+
+  static void destroy(void* object) noexcept {
+    if constexpr (IsInline) {
+      std::destroy_at(static_cast<T*>(object));
+    } else {
+      delete static_cast<T*>(object);
+    }
+  }
+
+  static constexpr ShapeViewDispatch view_table{
+      &FormatTo, &Calculate, &print, TypeIdOf<T>, TypeInfoOf<T>()};
+
+  static constexpr ShapeDispatch table{view_table, &clone, &move, &destroy};
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /* Main Type Erased Shape Class */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -203,8 +678,12 @@ class Shape {
   // Reference: https://en.cppreference.com/w/cpp/language/friend
   friend constexpr std::string Format<>(const Shape& shape);
 
+  friend constexpr void FormatTo<>(std::string& out, const Shape& shape);
+
   friend constexpr int Calculate<>(const Shape& shape);
 
+  friend ShapeView;
+
   friend std::ostream& operator<<(std::ostream& os, const Shape& shape) {
     return os << *shape.pimpl_;
   }
@@ -214,12 +693,47 @@ class Shape {
    public:
     constexpr virtual ~Interface() {}
     virtual void print(std::ostream& os) const = 0;
-    constexpr virtual std::string Format() const = 0;
+    // Appends to `out`, so that many shapes can be formatted into one string
+    // without a temporary per shape.
+    constexpr virtual void FormatTo(std::string& out) const = 0;
+    constexpr std::string Format() const {
+      std::string out;
+      FormatTo(out);
+      return out;
+    }
     constexpr virtual int Calculate() const = 0;
 
     // The Prototype Design Pattern
-    constexpr virtual std::unique_ptr<Interface> clone() const = 0;
+    // Copies the model into `buffer` when it fits, otherwise into memory from
+    // `resource`, or onto the heap if that is null.
+    constexpr virtual Interface* clone(
+        std::byte* buffer, std::pmr::memory_resource* resource) const = 0;
+    // Moves an inline model into `buffer`. A heap model is returned as is, so
+    // the owning pointer can simply be handed over.
+    constexpr virtual Interface* move(std::byte* buffer) noexcept = 0;
+    // Like `clone`, but moves the object into the new model. Used to move a
+    // heap model over to another memory resource.
+    constexpr virtual Interface* transfer(
+        std::byte* buffer, std::pmr::memory_resource* resource) = 0;
+    // Destroys the model and releases its memory to `resource`, or to the heap
+    // if that is null.
+    constexpr virtual void destroy(
+        std::pmr::memory_resource* resource) noexcept = 0;
+    // A view of the stored object, dispatching to it without this model.
+    constexpr virtual ShapeView view() const = 0;
+    // Bytes the model occupies outside the small buffer, 0 when inline.
+    constexpr virtual std::size_t HeapBytes() const noexcept = 0;
+    // The formatted object as a view of static storage, if it's a glyph or
+    // its raster was baked.
+    constexpr virtual std::optional<std::string_view> FormatView() const = 0;
+    // Empty unless the object is `ShapeHashable`.
+    constexpr virtual std::optional<std::size_t> Hash() const = 0;
+    // Compares with the model of another shape of the same type. An object
+    // which isn't `ShapeHashable` is only equal to itself.
+    constexpr virtual bool Equals(const Interface& other) const = 0;
+#if TYPE_ID_HAS_RTTI
     constexpr virtual std::type_index typeidx() const = 0;
+#endif
     friend std::ostream& operator<<(std::ostream& os, const Interface& shape) {
       shape.print(os);
       return os;
@@ -231,87 +745,449 @@ class Shape {
     friend Shape;
     T object_;
 
+    using Pool = TypePool<Model, ShapePoolFor<T> == ShapePool::ThreadLocal>;
+
+    // An empty, trivially copyable `T` has no state worth storing: any two of
+    // them are interchangeable. All shapes of such a type point at one shared
+    // model, which is all the dispatch table they need.
+    static constexpr bool Stateless = std::is_empty_v<T> &&
+                                      std::is_trivially_copyable_v<T> &&
+                                      std::is_trivially_default_constructible_v<T>;
+
+    // The small buffer and the shared model can't be used during constant
+    // evaluation, so there every model is allocated on the heap.
+    static constexpr bool StoredInline() {
+      if !consteval {
+        return IsInline<T> && !Stateless;
+      }
+      return false;
+    }
+
+    static constexpr bool StoredShared() {
+      if !consteval {
+        return Stateless;
+      }
+      return false;
+    }
+
+    // Never destroyed, shapes with static storage duration may still point at
+    // it during shutdown.
+    static Model& Shared() {
+      union Immortal {
+        Model model;
+        constexpr ~Immortal() {}
+      };
+      static constinit Immortal shared{Model{std::in_place}};
+      return shared.model;
+    }
+
    public:
-    constexpr Model(const T& value) : object_{value} {}
+    // Constructs the object directly inside the model.
+    template <class... Args>
+    constexpr explicit Model(std::in_place_t, Args&&... args)
+        : object_(std::forward<Args>(args)...) {}
+
+    template <class... Args>
+    static constexpr Interface* Create(std::byte* buffer,
+                                       std::pmr::memory_resource* resource,
+                                       Args&&... args) {
+      if (StoredInline()) {
+        return ::new (buffer) Model(std::in_place, std::forward<Args>(args)...);
+      }
+      if constexpr (Stateless) {
+        if !consteval {
+          // Constructed all the same, for whatever its constructor checks, but
+          // nothing of it needs to be kept.
+          static_cast<void>(T(std::forward<Args>(args)...));
+          return &Shared();
+        }
+      }
+#ifndef NDEBUG
+      if !consteval {
+        heap_allocations_.fetch_add(1, std::memory_order_relaxed);
+      }
+#endif
+      if (resource) {
+        void* memory = resource->allocate(sizeof(Model), alignof(Model));
+        try {
+          return ::new (memory) Model(std::in_place, std::forward<Args>(args)...);
+        } catch (...) {
+          resource->deallocate(memory, sizeof(Model), alignof(Model));
+          throw;
+        }
+      }
+      if constexpr (ShapePoolFor<T> != ShapePool::None) {
+        if !consteval {
+          void* memory = Pool::allocate();
+          try {
+            return ::new (memory)
+                Model(std::in_place, std::forward<Args>(args)...);
+          } catch (...) {
+            Pool::deallocate(memory);
+            throw;
+          }
+        }
+      }
+      return new Model(std::in_place, std::forward<Args>(args)...);
+    }
 
-    constexpr std::string Format() const override {
-      if constexpr (std::is_base_of_v<ShapeBaseCRTP<T>, T>) {
-        return static_cast<const ShapeBaseCRTP<T>&>(object_).Format();
-      } else if constexpr (ShapeHasMemberFormat<T>) {
-        return object_.Format();
-      } else if constexpr (ShapeHasStaticFormat<T>) {
-        using ::Format;
-        return Format(object_);
+    constexpr void FormatTo(std::string& out) const override {
+      ShapeFormatToCached(out, object_);
+    }
+
+    constexpr int Calculate() const override {
+      return ShapeCalculate(object_);
+    }
+
+    void print(std::ostream& os) const override { os << object_; }
+
+    // The Prototype Design Pattern
+    // A move only `T` can only be moved, copying its Shape throws.
+    constexpr Interface* clone(
+        std::byte* buffer, std::pmr::memory_resource* resource) const override {
+      if constexpr (Stateless) {
+        if !consteval {
+          return const_cast<Model*>(this);
+        }
+      }
+      if constexpr (std::is_copy_constructible_v<T>) {
+#ifndef NDEBUG
+        if !consteval {
+          clones_.fetch_add(1, std::memory_order_relaxed);
+        }
+#endif
+        return Create(buffer, resource, object_);
       } else {
-        static_assert(ShapeHasMemberFormat<T> || ShapeHasStaticFormat<T>,
-                      "No 'Format' method found for type 'T'.");
+        ThrowCopyOfMoveOnly();
       }
     }
 
-    constexpr int Calculate() const override {
-      if constexpr (std::is_base_of_v<ShapeBaseCRTP<T>, T>) {
-        return static_cast<const ShapeBaseCRTP<T>&>(object_).Calculate();
-      } else if constexpr (ShapeHasMemberCalculate<T>) {
-        return object_.Calculate();
-      } else if constexpr (ShapeHasStaticCalculate<T>) {
-        using ::Calculate;
-        return Calculate(object_);
+    constexpr Interface* move(std::byte* buffer) noexcept override {
+      if (StoredInline()) {
+        Interface* moved =
+            ::new (buffer) Model(std::in_place, std::move(object_));
+        std::destroy_at(this);
+        return moved;
+      }
+      return this;
+    }
+
+    constexpr Interface* transfer(
+        std::byte* buffer, std::pmr::memory_resource* resource) override {
+      return Create(buffer, resource, std::move(object_));
+    }
+
+    constexpr void destroy(
+        std::pmr::memory_resource* resource) noexcept override {
+      if (StoredShared()) {
+        return;
+      }
+      if (StoredInline()) {
+        std::destroy_at(this);
+      } else if (resource) {
+        std::destroy_at(this);
+        resource->deallocate(this, sizeof(Model), alignof(Model));
       } else {
-        static_assert(ShapeHasMemberCalculate<T> || ShapeHasStaticCalculate<T>,
-                      "No 'Calculate' method found for type 'T'.");
+        if constexpr (ShapePoolFor<T> != ShapePool::None) {
+          if !consteval {
+            std::destroy_at(this);
+            Pool::deallocate(this);
+            return;
+          }
+        }
+        delete this;
       }
     }
 
-    void print(std::ostream& os) const override { os << object_; }
+    constexpr ShapeView view() const override;
 
-    // The Prototype Design Pattern
-    constexpr std::unique_ptr<Interface> clone() const override {
-      return std::make_unique<Model>(*this);
+    constexpr std::size_t HeapBytes() const noexcept override {
+      return StoredInline() || StoredShared() ? 0 : sizeof(Model);
     }
 
+    constexpr std::optional<std::string_view> FormatView() const override {
+      if constexpr (ShapeIsGlyph<T>) {
+        return ShapeGlyph(object_);
+      } else if constexpr (ShapeHasBakedGlyph<T>) {
+        return BakedGlyph(object_);
+      } else {
+        return std::nullopt;
+      }
+    }
+
+    constexpr std::optional<std::size_t> Hash() const override {
+      if constexpr (ShapeHashable<T>) {
+        return ShapeHash(object_);
+      } else {
+        return std::nullopt;
+      }
+    }
+
+    constexpr bool Equals(const Interface& other) const override {
+      if constexpr (ShapeHashable<T>) {
+        return object_ == static_cast<const Model&>(other).object_;
+      } else {
+        return this == &other;
+      }
+    }
+
+#if TYPE_ID_HAS_RTTI
     constexpr std::type_index typeidx() const override { return typeid(T); }
+#endif
   };
 
+  // The Small Buffer Optimization
+  // Only models which are small enough and nothrow movable are stored inline,
+  // moving a Shape must never throw.
+  static constexpr std::size_t BufferSize = SHAPE_BUFFER_SIZE;
+
+  template <class T>
+  static constexpr bool IsInline =
+      sizeof(Model<T>) <= BufferSize &&
+      alignof(Model<T>) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<T>;
+
+#ifndef NDEBUG
+  static inline std::atomic<std::size_t> heap_allocations_{0};
+  static inline std::atomic<std::size_t> clones_{0};
+#endif
+
   // The Bridge Design Pattern
-  std::unique_ptr<Interface> pimpl_;
+  // Points into `buffer_` for inline models, otherwise owns a heap model.
+  Interface* pimpl_{nullptr};
+  // The type of the model, kept in the handle so that `is<T>()` neither
+  // follows `pimpl_` nor makes a virtual call.
+  TypeId id_{};
+  // Where models which don't fit `buffer_` are allocated. Null for the global
+  // heap, which is also the only choice during constant evaluation.
+  std::pmr::memory_resource* resource_{nullptr};
+  alignas(std::max_align_t) std::byte buffer_[BufferSize];
+
+  static std::pmr::memory_resource* ResourceOf(const auto& alloc) {
+    std::pmr::memory_resource* resource = alloc.resource();
+    return resource == std::pmr::new_delete_resource() ? nullptr : resource;
+  }
 
  public:
-  // A constructor template to create a bridge.
+  // Makes Shape allocator aware, a `std::pmr::vector<Shape>` hands its memory
+  // resource down to the shapes inside it.
+  //
+  // Copies do not inherit the resource of the shape they are copied from. Like
+  // with the `std::pmr` containers, a copy allocates from the heap unless it's
+  // given an allocator, and a shape which is copy assigned to keeps its own
+  // resource. So a copy can't outlive an arena it was never placed in. A moved
+  // shape takes its model, and so its resource, along.
+  using allocator_type = std::pmr::polymorphic_allocator<>;
+
+  // A constructor template to create a bridge. The object is forwarded, so a
+  // temporary is moved into the model instead of copied.
+  template <class T>
+    requires(!std::same_as<std::remove_cvref_t<T>, Shape> &&
+             !IsInPlaceType<std::remove_cvref_t<T>> &&
+             ShapeErasable<std::remove_cvref_t<T>>)
+  constexpr Shape(T&& x)
+      : Shape{std::in_place_type<std::remove_cvref_t<T>>, std::forward<T>(x)} {}
+
+  // Constructs the `T` from `args` right where the model stores it.
+  template <class T, class... Args>
+  constexpr explicit Shape(std::in_place_type_t<T>, Args&&... args)
+      : pimpl_{Model<T>::Create(buffer_, nullptr, std::forward<Args>(args)...)},
+        id_{TypeIdOf<T>} {}
+
+  // The same, but a model which doesn't fit the small buffer is allocated
+  // through `alloc`.
   template <class T>
-  constexpr Shape(const T& x) : pimpl_{new Model<T>(x)} {}
+    requires(!std::same_as<std::remove_cvref_t<T>, Shape> &&
+             !IsInPlaceType<std::remove_cvref_t<T>> &&
+             ShapeErasable<std::remove_cvref_t<T>>)
+  Shape(std::allocator_arg_t, const allocator_type& alloc, T&& x)
+      : Shape{std::allocator_arg, alloc,
+              std::in_place_type<std::remove_cvref_t<T>>, std::forward<T>(x)} {}
+
+  template <class T, class... Args>
+  Shape(std::allocator_arg_t, const allocator_type& alloc,
+        std::in_place_type_t<T>, Args&&... args)
+      : pimpl_{Model<T>::Create(buffer_, ResourceOf(alloc),
+                                std::forward<Args>(args)...)},
+        id_{TypeIdOf<T>},
+        resource_{ResourceOf(alloc)} {}
+
+  constexpr Shape(const Shape& s)
+      : pimpl_{s.pimpl_ ? s.pimpl_->clone(buffer_, nullptr) : nullptr},
+        id_{s.id_} {}
+
+  constexpr Shape(Shape&& s) noexcept
+      : pimpl_{s.pimpl_ ? s.pimpl_->move(buffer_) : nullptr},
+        id_{s.id_},
+        resource_{s.resource_} {
+    s.pimpl_ = nullptr;
+    s.id_ = TypeId{};
+  }
 
-  constexpr Shape(const Shape& s) : pimpl_{s.pimpl_->clone()} {}
+  Shape(std::allocator_arg_t, const allocator_type& alloc, const Shape& s)
+      : pimpl_{s.pimpl_ ? s.pimpl_->clone(buffer_, ResourceOf(alloc))
+                        : nullptr},
+        id_{s.id_},
+        resource_{ResourceOf(alloc)} {}
+
+  // Moves the model if it is inline or already allocated from `alloc`,
+  // otherwise moves the object into a new model allocated from `alloc`.
+  Shape(std::allocator_arg_t, const allocator_type& alloc, Shape&& s)
+      : id_{s.id_}, resource_{ResourceOf(alloc)} {
+    if (!s.pimpl_) return;
+    if (s.resource_ == resource_) {
+      pimpl_ = s.pimpl_->move(buffer_);
+      s.pimpl_ = nullptr;
+      s.id_ = TypeId{};
+    } else {
+      pimpl_ = s.pimpl_->transfer(buffer_, resource_);
+    }
+  }
 
-  constexpr Shape(Shape&& s) noexcept : pimpl_{std::move(s.pimpl_)} {}
+  constexpr ~Shape() {
+    if (pimpl_) pimpl_->destroy(resource_);
+  }
 
   constexpr Shape& operator=(const Shape& s) {
-    pimpl_ = s.pimpl_->clone();
+    if (this != &s) {
+      Shape copy = resource_ ? Shape{std::allocator_arg, get_allocator(), s}
+                             : Shape{s};
+      *this = std::move(copy);
+    }
     return *this;
   }
 
   constexpr Shape& operator=(Shape&& s) noexcept {
-    pimpl_ = std::move(s.pimpl_);
+    if (this != &s) {
+      if (pimpl_) pimpl_->destroy(resource_);
+      pimpl_ = s.pimpl_ ? s.pimpl_->move(buffer_) : nullptr;
+      id_ = s.id_;
+      resource_ = s.resource_;
+      s.pimpl_ = nullptr;
+      s.id_ = TypeId{};
+    }
     return *this;
   }
 
-  constexpr std::type_index typeidx() const { return pimpl_->typeidx(); }
+  // Replaces the shape with a `T` constructed from `args`. If that throws, the
+  // shape is left empty.
+  //
+  // The old object is destroyed first, so `args` must not refer into it. To
+  // build the new object from the old one, copy what's needed out first, or
+  // assign a new `Shape`.
+  template <class T, class... Args>
+  constexpr T& emplace(Args&&... args) {
+    if (pimpl_) pimpl_->destroy(resource_);
+    pimpl_ = nullptr;
+    id_ = TypeId{};
+    pimpl_ = Model<T>::Create(buffer_, resource_, std::forward<Args>(args)...);
+    id_ = TypeIdOf<T>;
+    return static_cast<Model<T>&>(*pimpl_).object_;
+  }
+
+  allocator_type get_allocator() const {
+    return resource_ ? resource_ : std::pmr::new_delete_resource();
+  }
+
+#ifndef NDEBUG
+  // Number of models which did not fit the small buffer and had to be
+  // allocated on the heap. Only tracked in debug builds.
+  static std::size_t HeapAllocations() {
+    return heap_allocations_.load(std::memory_order_relaxed);
+  }
+
+  // Number of models copied by copying a Shape. Only tracked in debug builds.
+  static std::size_t Clones() {
+    return clones_.load(std::memory_order_relaxed);
+  }
+#endif
 
+  // Hits and misses of the pool recycling the heap models of `T`, see
+  // `ShapePoolFor`. Per thread for `ShapePool::ThreadLocal`.
+  template <class T>
+  static PoolStats ModelPoolStats() {
+    return Model<T>::Pool::stats();
+  }
+
+  // Bytes of memory the model takes up outside the Shape itself, 0 when it
+  // lives in the small buffer.
+  constexpr std::size_t HeapBytes() const {
+    return pimpl_ ? pimpl_->HeapBytes() : 0;
+  }
+
+  constexpr TypeId id() const { return id_; }
+
+  // What `Format` returns, without copying it, for shapes which are a glyph
+  // or whose raster was baked at compile time. Empty for all others. The view
+  // stays valid after the shape is gone.
+  constexpr std::optional<std::string_view> FormatView() const {
+    return pimpl_ ? pimpl_->FormatView() : std::nullopt;
+  }
+
+  // The hash of the object mixed with its type, if the type has the hooks.
+  std::optional<std::size_t> hash() const {
+    if (!pimpl_) return std::nullopt;
+    const std::optional<std::size_t> object = pimpl_->Hash();
+    if (!object) return std::nullopt;
+    // The boost::hash_combine recipe.
+    const std::size_t type = std::hash<TypeId>{}(id_);
+    return type ^ (*object + 0x9e3779b9 + (type << 6) + (type >> 2));
+  }
+
+  // True if both hold equal objects of the same type. Without the hooks a
+  // shape only equals itself, or shapes sharing its model.
+  constexpr bool equals(const Shape& other) const {
+    return id_ == other.id_ && pimpl_ && other.pimpl_ &&
+           pimpl_->Equals(*other.pimpl_);
+  }
+
+#if TYPE_ID_HAS_RTTI
+  // `typeid(void)` for an empty shape.
+  constexpr std::type_index typeidx() const {
+    return pimpl_ ? pimpl_->typeidx() : typeid(void);
+  }
+#endif
+
+  // Unchecked in release builds, the caller must know the shape holds a `T`.
   template <class T>
   constexpr T& as() {
+    assert(is<T>() && "The shape does not hold a T!");
     return static_cast<Model<T>&>(*pimpl_).object_;
   }
 
   template <class T>
   constexpr const T& as() const {
+    assert(is<T>() && "The shape does not hold a T!");
     return static_cast<const Model<T>&>(*pimpl_).object_;
   }
 
+  // The object if the shape holds a `T`, otherwise nullptr.
+  template <class T>
+  constexpr T* try_as() {
+    return is<T>() ? &static_cast<Model<T>&>(*pimpl_).object_ : nullptr;
+  }
+
+  template <class T>
+  constexpr const T* try_as() const {
+    return is<T>() ? &static_cast<const Model<T>&>(*pimpl_).object_ : nullptr;
+  }
+
+  // False for an empty or moved from shape.
   template <class T>
   constexpr bool is() const {
-    return pimpl_->typeidx() == typeid(T);
+    return pimpl_ && id_ == TypeIdOf<T>;
   }
 };
 
+// Nothrow movable, but with a small buffer, so not trivially relocatable. See
+// Relocation.hpp.
+static_assert(std::is_nothrow_move_constructible_v<Shape> &&
+              std::is_nothrow_move_assignable_v<Shape>);
+static_assert(!IsTriviallyRelocatable<Shape> && !IsPointerSizedHandle<Shape>);
+// A container of shapes is not itself a shape, so `std::vector<Shape>{shapes}`
+// can't wrap the whole vector into a single element.
+static_assert(!std::is_constructible_v<Shape, std::vector<Shape>>);
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /* Type Erased Shape Pointer Class */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -327,126 +1203,227 @@ class ShapeView {
   // Reference: https://en.cppreference.com/w/cpp/language/friend
   friend constexpr std::string Format<>(const ShapeView& shape);
 
+  friend constexpr void FormatTo<>(std::string& out, const ShapeView& shape);
+
   friend constexpr int Calculate<>(const ShapeView& shape);
 
   friend std::ostream& operator<<(std::ostream& os, const ShapeView& shape) {
-    return os << *shape.pimpl_;
+    shape.dispatch_->print(shape.object_, os);
+    return os;
   }
 
-  // The External Polymorphism Design Pattern
-  class Interface {
-   public:
-    constexpr virtual ~Interface() {}
-    virtual void print(std::ostream& os) const = 0;
-    constexpr virtual std::string Format() const = 0;
-    constexpr virtual int Calculate() const = 0;
+  // A view does not own anything, so there is no model to allocate. It is just
+  // the viewed object and the dispatch table of its type.
+  const void* object_{nullptr};
+  const ShapeViewDispatch* dispatch_{nullptr};
 
-    // The Prototype Design Pattern
-    constexpr virtual std::unique_ptr<Interface> clone() const = 0;
-    constexpr virtual std::type_index typeidx() const = 0;
-    constexpr virtual bool is(std::type_index idx) const = 0;
-    friend std::ostream& operator<<(std::ostream& os, const Interface& shape) {
-      shape.print(os);
-      return os;
-    }
-  };
+  // Containers which keep the dispatch table of each object themselves hand
+  // out views of it.
+  friend class PackedShapeBuffer;
+
+  constexpr ShapeView(const void* object, const ShapeViewDispatch* dispatch)
+      : object_{object}, dispatch_{dispatch} {}
 
+ public:
   template <class T>
-  class Model : public Interface {
-    friend Shape;
-    T* object_;
+    requires(!std::same_as<std::remove_const_t<T>, Shape> &&
+             !std::same_as<std::remove_const_t<T>, TableShape>)
+  constexpr ShapeView(T* x)
+      : object_{x},
+        dispatch_{&ShapeDispatchModel<std::remove_const_t<T>>::view_table} {}
 
-   public:
-    constexpr Model(T* value) : object_{value} {}
+  // Binds straight to the object erased inside the shape, rather than to the
+  // shape itself. Calls through the view then cost the same as calls through
+  // the owning shape. Like any pointer into the shape, the view is invalidated
+  // when the shape is moved or destroyed.
+  constexpr ShapeView(const Shape& shape);
 
-    constexpr std::string Format() const override {
-      if constexpr (std::is_base_of_v<ShapeBaseCRTP<T>, T>) {
-        return static_cast<const ShapeBaseCRTP<T>&>(*object_).Format();
-      } else if constexpr (ShapeHasMemberFormat<T>) {
-        return object_->Format();
-      } else if constexpr (ShapeHasStaticFormat<T>) {
-        using ::Format;
-        return Format(*object_);
-      } else {
-        static_assert(ShapeHasMemberFormat<T> || ShapeHasStaticFormat<T>,
-                      "No 'Format' method found for type 'T'.");
-      }
-    }
+  ShapeView(const TableShape& shape);
 
-    constexpr int Calculate() const override {
-      if constexpr (std::is_base_of_v<ShapeBaseCRTP<T>, T>) {
-        return static_cast<const ShapeBaseCRTP<T>&>(*object_).Calculate();
-      } else if constexpr (ShapeHasMemberCalculate<T>) {
-        return object_->Calculate();
-      } else if constexpr (ShapeHasStaticCalculate<T>) {
-        using ::Calculate;
-        return Calculate(*object_);
-      } else {
-        static_assert(ShapeHasMemberCalculate<T> || ShapeHasStaticCalculate<T>,
-                      "No 'Calculate' method found for type 'T'.");
-      }
-    }
+  constexpr ShapeView(const Shape* shape) : ShapeView{*shape} {}
 
-    void print(std::ostream& os) const override { os << *object_; }
+  ShapeView(const TableShape* shape);
 
-    // The Prototype Design Pattern
-    constexpr std::unique_ptr<Interface> clone() const override {
-      return std::make_unique<Model>(*this);
-    }
+  // Views the shape behind a handle into a `ShapeStore`, see ShapeStore.hpp.
+  // The view of a stale handle is empty.
+  ShapeView(const ShapeStore& store, ShapeHandle handle);
 
-    constexpr std::type_index typeidx() const override { return typeid(T); }
+  // A view of an empty or moved from shape is empty. It is of no type, and
+  // can't be formatted or calculated.
+  constexpr bool empty() const { return dispatch_ == nullptr; }
 
-    constexpr virtual bool is(std::type_index idx) const {
-      return typeid(T) == idx;
-    }
-  };
+  constexpr TypeId id() const { return dispatch_ ? dispatch_->id : TypeId{}; }
 
-  // The Bridge Design Pattern
-  std::unique_ptr<Interface> pimpl_;
+#if TYPE_ID_HAS_RTTI
+  constexpr std::type_index typeidx() const {
+    return dispatch_ ? *dispatch_->type : typeid(void);
+  }
+#endif
 
- public:
-  // A constructor template to create a bridge.
+  // Unchecked in release builds, the caller must know the view is of a `T`.
+  // A view may be bound to a const object, so it only ever hands out const
+  // access; modify the object through its owner instead.
   template <class T>
-  constexpr ShapeView(T* x) : pimpl_{new Model<T>(x)} {}
+  constexpr const T& as() const {
+    assert(is<T>() && "The view is not of a T!");
+    return *static_cast<const T*>(object_);
+  }
+
+  // The object if the view is of a `T`, otherwise nullptr.
+  template <class T>
+  constexpr const T* try_as() const {
+    return is<T>() ? static_cast<const T*>(object_) : nullptr;
+  }
+
+  template <class T>
+  constexpr bool is() const {
+    return dispatch_ && dispatch_->id == TypeIdOf<T>;
+  }
+};
 
-  constexpr ShapeView(const ShapeView& s) : pimpl_{s.pimpl_->clone()} {}
+// Copying a view copies two pointers.
+static_assert(std::is_trivially_copyable_v<ShapeView>);
+static_assert(sizeof(ShapeView) == 2 * sizeof(void*));
 
-  constexpr ShapeView(ShapeView&& s) noexcept : pimpl_{std::move(s.pimpl_)} {}
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Type Erased Shape Class With A Hand Rolled Dispatch Table */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Same interface and small buffer as `Shape`, but instead of a pointer to an
+// `Interface` it holds a pointer to the `ShapeDispatch` table of the stored
+// type and a pointer to the object itself.
+class TableShape {
+  friend constexpr std::string Format<>(const TableShape& shape);
+
+  friend constexpr void FormatTo<>(std::string& out, const TableShape& shape);
+
+  friend constexpr int Calculate<>(const TableShape& shape);
+
+  friend ShapeView;
+
+  friend std::ostream& operator<<(std::ostream& os, const TableShape& shape) {
+    shape.dispatch_->print(shape.object_, os);
+    return os;
+  }
+
+  const ShapeDispatch* dispatch_{nullptr};
+  // Points into `buffer_` for inline objects, otherwise owns a heap object.
+  void* object_{nullptr};
+  alignas(std::max_align_t) std::byte buffer_[SHAPE_BUFFER_SIZE];
 
-  constexpr ShapeView& operator=(const ShapeView& s) {
-    pimpl_ = s.pimpl_->clone();
+ public:
+  template <class T>
+    requires(!std::same_as<std::remove_cvref_t<T>, TableShape> &&
+             !IsInPlaceType<std::remove_cvref_t<T>> &&
+             ShapeErasable<std::remove_cvref_t<T>>)
+  TableShape(T&& x)
+      : TableShape{std::in_place_type<std::remove_cvref_t<T>>,
+                   std::forward<T>(x)} {}
+
+  template <class T, class... Args>
+  explicit TableShape(std::in_place_type_t<T>, Args&&... args)
+      : dispatch_{&ShapeDispatchModel<T>::table},
+        object_{ShapeDispatchModel<T>::Create(buffer_,
+                                              std::forward<Args>(args)...)} {}
+
+  TableShape(const TableShape& s)
+      : dispatch_{s.dispatch_},
+        object_{s.dispatch_ ? s.dispatch_->clone(s.object_, buffer_) : nullptr} {}
+
+  TableShape(TableShape&& s) noexcept
+      : dispatch_{s.dispatch_},
+        object_{s.dispatch_ ? s.dispatch_->move(s.object_, buffer_) : nullptr} {
+    s.dispatch_ = nullptr;
+    s.object_ = nullptr;
+  }
+
+  ~TableShape() {
+    if (dispatch_) dispatch_->destroy(object_);
+  }
+
+  TableShape& operator=(const TableShape& s) {
+    if (this != &s) {
+      TableShape copy{s};
+      *this = std::move(copy);
+    }
     return *this;
   }
 
-  constexpr ShapeView& operator=(ShapeView&& s) noexcept {
-    pimpl_ = std::move(s.pimpl_);
+  TableShape& operator=(TableShape&& s) noexcept {
+    if (this != &s) {
+      if (dispatch_) dispatch_->destroy(object_);
+      dispatch_ = s.dispatch_;
+      object_ = s.dispatch_ ? s.dispatch_->move(s.object_, buffer_) : nullptr;
+      s.dispatch_ = nullptr;
+      s.object_ = nullptr;
+    }
     return *this;
   }
 
-  constexpr std::type_index typeidx() const { return pimpl_->typeidx(); }
+  TypeId id() const { return dispatch_ ? dispatch_->id : TypeId{}; }
+
+#if TYPE_ID_HAS_RTTI
+  std::type_index typeidx() const {
+    return dispatch_ ? *dispatch_->type : typeid(void);
+  }
+#endif
 
+  // Unchecked in release builds, the caller must know the shape holds a `T`.
   template <class T>
-  constexpr T& as() {
-    return static_cast<Model<T>&>(*pimpl_).object_;
+  T& as() {
+    assert(is<T>() && "The shape does not hold a T!");
+    return *static_cast<T*>(object_);
   }
 
   template <class T>
-  constexpr const T& as() const {
-    return static_cast<const Model<T>&>(*pimpl_).object_;
+  const T& as() const {
+    assert(is<T>() && "The shape does not hold a T!");
+    return *static_cast<const T*>(object_);
   }
 
+  // The object if the shape holds a `T`, otherwise nullptr.
   template <class T>
-  constexpr bool is() const {
-    return pimpl_->is(typeid(T));
+  T* try_as() {
+    return is<T>() ? static_cast<T*>(object_) : nullptr;
+  }
+
+  template <class T>
+  const T* try_as() const {
+    return is<T>() ? static_cast<const T*>(object_) : nullptr;
+  }
+
+  template <class T>
+  bool is() const {
+    return dispatch_ && dispatch_->id == TypeIdOf<T>;
   }
 };
 
+// Turns away the same types as `Shape` does.
+static_assert(!std::is_constructible_v<TableShape, std::vector<TableShape>>);
+
+template <class T>
+constexpr ShapeView Shape::Model<T>::view() const {
+  return ShapeView{&object_};
+}
+
+constexpr ShapeView::ShapeView(const Shape& shape)
+    : ShapeView{shape.pimpl_ ? shape.pimpl_->view()
+                             : ShapeView{nullptr, nullptr}} {}
+
+inline ShapeView::ShapeView(const TableShape& shape)
+    : object_{shape.object_}, dispatch_{shape.dispatch_} {}
+
+inline ShapeView::ShapeView(const TableShape* shape) : ShapeView{*shape} {}
 
 template <>
 constexpr std::string Format(const Shape& shape) {
   return shape.pimpl_->Format();
 }
 
+template <>
+constexpr void FormatTo(std::string& out, const Shape& shape) {
+  shape.pimpl_->FormatTo(out);
+}
+
 template <>
 constexpr int Calculate(const Shape& shape) {
   return shape.pimpl_->Calculate();
@@ -454,12 +1431,39 @@ constexpr int Calculate(const Shape& shape) {
 
 template <>
 constexpr std::string Format(const ShapeView& shape) {
-  return shape.pimpl_->Format();
+  assert(!shape.empty() && "Formatting an empty view!");
+  std::string out;
+  shape.dispatch_->FormatTo(shape.object_, out);
+  return out;
+}
+
+template <>
+constexpr void FormatTo(std::string& out, const ShapeView& shape) {
+  assert(!shape.empty() && "Formatting an empty view!");
+  shape.dispatch_->FormatTo(shape.object_, out);
 }
 
 template <>
 constexpr int Calculate(const ShapeView& shape) {
-  return shape.pimpl_->Calculate();
+  assert(!shape.empty() && "Calculating an empty view!");
+  return shape.dispatch_->Calculate(shape.object_);
+}
+
+template <>
+constexpr std::string Format(const TableShape& shape) {
+  std::string out;
+  shape.dispatch_->FormatTo(shape.object_, out);
+  return out;
+}
+
+template <>
+constexpr void FormatTo(std::string& out, const TableShape& shape) {
+  shape.dispatch_->FormatTo(shape.object_, out);
+}
+
+template <>
+constexpr int Calculate(const TableShape& shape) {
+  return shape.dispatch_->Calculate(shape.object_);
 }
 
 
@@ -474,20 +1478,23 @@ class Circle {
   constexpr explicit Circle(double radius) : radius_(radius) {}
 
   constexpr double radius() const { return radius_; }
+
+  friend constexpr bool operator==(const Circle&, const Circle&) = default;
 };
 
 std::ostream& operator<<(std::ostream& os, const Circle& circle) {
   return os << "Circle(radius = " << circle.radius() << ")";
 }
 
-constexpr std::string Format(const Circle& circle) {
+// Appends to the caller's string rather than returning a new one. Rendering a
+// scene into one reused string then costs no allocation per circle.
+constexpr void FormatTo(std::string& out, const Circle& circle) {
   // - Iterate through the grid from -radius to +radius for both x and y
   // - Check if the point (x, y) is close enough to the circle's equation
   // (scaled for width)
   // - Append star for a circle point
   // - Otherwise, append space
   // - Add a newline after each row
-  std::string out;
   for (int y = -circle.radius(); y <= circle.radius(); ++y) {
     for (int x = -2 * circle.radius(); x <= 2 * circle.radius(); ++x) {
       if (absolute(x * x / 4 + y * y - circle.radius() * circle.radius()) <=
@@ -498,12 +1505,23 @@ constexpr std::string Format(const Circle& circle) {
     }
     out += "\n";
   }
+}
 
+// The original interface, kept as a thin wrapper.
+constexpr std::string Format(const Circle& circle) {
+  std::string out;
+  FormatTo(out, circle);
   return out;
 }
 
 constexpr int Calculate(const Circle& circle) { return 42; }
 
+// Along with `==`, makes equal circles interchangeable. Like `Calculate`, it
+// may be a free function...
+inline std::size_t Hash(const Circle& circle) {
+  return std::hash<double>{}(circle.radius());
+}
+
 class Square {
   double width_;
 
@@ -512,16 +1530,20 @@ class Square {
 
   constexpr double width() const { return width_; }
 
-  // This Format method is implemented as a member function and still works for
-  // a Shape.
-  constexpr std::string Format() const {
+  // ... or a member.
+  std::size_t Hash() const { return std::hash<double>{}(width_); }
+
+  friend constexpr bool operator==(const Square&, const Square&) = default;
+
+  // This FormatTo method is implemented as a member function and still works
+  // for a Shape.
+  constexpr void FormatTo(std::string& box) const {
     const char TOP_LEFT = 0xC9;      // ASCII: 201
     const char TOP_RIGHT = 0xBB;     // ASCII: 187
     const char BOTTOM_LEFT = 0xC8;   // ASCII: 200
     const char BOTTOM_RIGHT = 0xBC;  // ASCII: 188
     const char HORIZONTAL = 0xCD;    // ASCII: 205
     const char VERTICAL = 0xB3;      // ASCII: 186
-    std::string box;
     box += TOP_LEFT;
     for (int i = 0; i < width() - 2; ++i) {
       box += HORIZONTAL;
@@ -544,7 +1566,11 @@ class Square {
     }
     box += BOTTOM_RIGHT;
     box += "\n";
+  }
 
+  constexpr std::string Format() const {
+    std::string box;
+    FormatTo(box);
     return box;
   }
 };
@@ -563,10 +1589,16 @@ class Triangle {
 
   constexpr double radius() const { return size; }
 
+  std::size_t Hash() const { return std::hash<double>{}(size); }
+
+  friend constexpr bool operator==(const Triangle&, const Triangle&) = default;
+
   friend std::ostream& operator<<(std::ostream& os, const Triangle& circle) {
     return os << "Triangle(size = " << circle.radius() << ")";
   }
 
+  // A plain Format returning a new string still works, the result is appended
+  // by whoever asked for FormatTo.
   constexpr std::string Format() const {
     std::string ret{""};
     for (int i = 0; i < size; ++i) {
@@ -580,6 +1612,46 @@ class Triangle {
   constexpr int Calculate() const { return 42; }
 };
 
+// Every circle, square and triangle of the same size rasterizes into the same
+// rows, so shapes of them are formatted through the render cache. This has to
+// be said before the first Shape of them is created.
+template <>
+inline constexpr bool ShapeRenderCacheFor<Circle> = true;
+
+template <>
+inline constexpr bool ShapeRenderCacheFor<Square> = true;
+
+template <>
+inline constexpr bool ShapeRenderCacheFor<Triangle> = true;
+
+// The sizes we draw the most are rasterized by the compiler. Formatting them
+// copies a string_view of read only data, `FormatView` doesn't even do that.
+// Like the render cache, this has to come before the first Shape of them.
+constexpr std::optional<std::string_view> BakedGlyph(const Circle& circle) {
+  if (circle.radius() == 5.0) return ShapeGlyphTable<Circle, 5.0>::glyph;
+  if (circle.radius() == 10.0) return ShapeGlyphTable<Circle, 10.0>::glyph;
+  return std::nullopt;
+}
+
+constexpr std::optional<std::string_view> BakedGlyph(const Square& square) {
+  if (square.width() == 10.0) return ShapeGlyphTable<Square, 10.0>::glyph;
+  return std::nullopt;
+}
+
+constexpr std::optional<std::string_view> BakedGlyph(
+    const Triangle& triangle) {
+  if (triangle.radius() == 10.0) return ShapeGlyphTable<Triangle, 10.0>::glyph;
+  return std::nullopt;
+}
+
+// Every baked table must match what formatting at run time produces.
+static_assert(*BakedGlyph(Circle{5.0}) == ShapeFormat(Circle{5.0}) &&
+              *BakedGlyph(Circle{10.0}) == ShapeFormat(Circle{10.0}) &&
+              *BakedGlyph(Square{10.0}) == ShapeFormat(Square{10.0}) &&
+              *BakedGlyph(Triangle{10.0}) == ShapeFormat(Triangle{10.0}));
+static_assert(!BakedGlyph(Circle{7.0}) && !BakedGlyph(Square{4.0}) &&
+              !BakedGlyph(Triangle{5.0}));
+
 // 1. Making it constexpr.
 // - Interface may have constexpr virtual functions from C++20
 // - std::unique_ptr is constexpr from C++23
@@ -587,13 +1659,29 @@ class Triangle {
 // class is constexpr viable. To be more specific, you may instantiate
 // this class in a constexpr context but you may not return it outside
 // of said context. This will result in an invalid use of interpreted memory.
-// Generating strings is complicated at compile time, is a topic for another
-// blog post.
+// Generating strings is complicated at compile time: a string may be built,
+// but not kept. Copying it into a std::array which can be kept is how the
+// glyphs above are baked.
 static constexpr int CxCalculateShape = []() constexpr {
   Shape cx_shape{Circle{5.0}};
   return Calculate(cx_shape);
 }();
 
+// A ShapeView holds no memory at all, so unlike a Shape it may even escape the
+// constant evaluation. Calling through it casts the object back from
+// `const void*`, which is only allowed at compile time since C++26.
+static constexpr Circle cx_circle{5.0};
+static constexpr ShapeView cx_view{&cx_circle};
+#if __cpp_constexpr >= 202306L
+static constexpr int CxCalculateView = Calculate(cx_view);
+#endif
+
+// Checking the type needs neither the object nor RTTI, just the table.
+static_assert(cx_view.is<Circle>() && !cx_view.is<Square>());
+// Even a non-const view hands out only const access.
+static_assert(std::is_same_v<decltype(std::declval<ShapeView&>().as<Circle>()),
+                             const Circle&>);
+
 // 2. Allowing the use to optionally provide a structurally conforming type
 // instead of forcing them to write a static interface. This is optional, as it
 // changes the semantics of the Shape class, perhaps you do not wish to ever use
@@ -689,10 +1777,19 @@ Then use it like so:
                [](const Shape& shape) { return shape.is<Square>(); });
   if (square_loc != shapes.end()) {
     // I found it!
-    my_square = &shapes.back().as<Square>();
+    my_square = &square_loc->as<Square>();
   }
   assert(square_loc != shapes.end() && "I lost my square!");
 
+Checking with is<T>() and then calling as<T>() is easy to get wrong, the found
+iterator has to be the one that is cast. try_as<T>() does both at once and
+returns nullptr when the shape holds something else:
+
+  for (Shape& shape : shapes) {
+    if (Square* square = shape.try_as<Square>()) {
+      // Only squares get here.
+    }
+  }
 */
 
 // 4. Providing the user with a default base implementation, while also allowing
@@ -710,7 +1807,8 @@ struct ShapeBase {
 
 struct Pyramid : public ShapeBase {
  public:
-  constexpr std::string Format() const {
+  // Static storage, so the glyph can be handed out without copying it.
+  static constexpr std::string_view Glyph() {
     return
         R"(
                '
@@ -732,6 +1830,8 @@ struct Pyramid : public ShapeBase {
 )";
     ;
   }
+
+  constexpr std::string Format() const { return std::string{Glyph()}; }
 };
 
 // But what if the user wants to use a static Format function instead of a
@@ -739,7 +1839,7 @@ struct Pyramid : public ShapeBase {
 // shape base the bat will not be drawn.
 struct Bat : public ShapeBase {};
 
-constexpr std::string Format(const Bat& bat) {
+constexpr std::string_view Glyph(const Bat&) {
   return
       R"(
                  _..__.          .__.._
@@ -749,6 +1849,10 @@ constexpr std::string Format(const Bat& bat) {
 )";
 }
 
+constexpr std::string Format(const Bat& bat) {
+  return std::string{Glyph(bat)};
+}
+
 // We can implement a more flexible base class using CRTP (Curiously Recurring
 // Template Parameter) pattern.
 
@@ -778,7 +1882,7 @@ overflow (parameters: 0x0000000000000001, 0x00000090B6AB3F48).
 // the husky. When calling Format from Shape.
 struct Husky : ShapeBaseCRTP<Husky> {};
 
-constexpr std::string Format(const Husky& bat) {
+constexpr std::string_view Glyph(const Husky&) {
   return
       R"(
                                 ;\ 
@@ -806,6 +1910,10 @@ constexpr std::string Format(const Husky& bat) {
 )";
 }
 
+constexpr std::string Format(const Husky& bat) {
+  return std::string{Glyph(bat)};
+}
+
 // Last layer of indirection. We can add one more layer of indirection to
 // completley remove all responsibility from the to user to inherit our
 // ShapeBase.
@@ -836,9 +1944,306 @@ struct IndirectShape : T, ShapeBaseCRTP<IndirectShape<T>>
 // object. What if i simply want to store a pointer to any Shape - compatible
 // class ?
 
+// What if the shape is too large for the small buffer? Its model then has to
+// be allocated. By default that is the global heap, but a Shape can be given a
+// std::pmr::memory_resource to allocate from instead. Backing a frame's shapes
+// with a monotonic buffer frees all of them with a single release().
+class Polygon {
+  std::array<double, 8> sides_{};
+
+ public:
+  constexpr explicit Polygon(double side) { sides_.fill(side); }
+
+  constexpr double perimeter() const {
+    double perimeter = 0.0;
+    for (double side : sides_) {
+      perimeter += side;
+    }
+    return perimeter;
+  }
+
+  constexpr void FormatTo(std::string& out) const {
+    out += "  ____  \n /    \\ \n/      \\\n\\      /\n \\____/ \n";
+  }
+
+  constexpr std::string Format() const {
+    std::string out;
+    FormatTo(out);
+    return out;
+  }
+
+  constexpr int Calculate() const { return 42; }
+
+  friend std::ostream& operator<<(std::ostream& os, const Polygon& polygon) {
+    return os << "Polygon(perimeter = " << polygon.perimeter() << ")";
+  }
+};
+
+// What if the shape can't be copied at all? A Stamp owns its glyph through a
+// std::unique_ptr. Shape forwards its argument into the model, so a Stamp can
+// be moved in, or even built in place, and the Shape can be moved around.
+// Copying that Shape throws, only the model knows that it can't be copied.
+class Stamp {
+  std::unique_ptr<std::string> glyph_;
+
+ public:
+  explicit Stamp(std::string glyph)
+      : glyph_{std::make_unique<std::string>(std::move(glyph))} {}
+
+  void FormatTo(std::string& out) const { out += *glyph_; }
+
+  std::string Format() const { return *glyph_; }
+
+  int Calculate() const { return static_cast<int>(glyph_->size()); }
+
+  friend std::ostream& operator<<(std::ostream& os, const Stamp& stamp) {
+    return os << "Stamp(" << *stamp.glyph_ << ")";
+  }
+};
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /* Application */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The ids are compared at runtime, and reported without `assert`, so that the
+// check also runs in Release builds, which fold identical COMDATs.
+static int TypeIdDemo() {
+  // Called through volatile pointers, so the comparisons can't be folded into
+  // constants at compile time.
+  TypeId (*volatile circle)() = &TypeId::Of<Circle>;
+  TypeId (*volatile square)() = &TypeId::Of<Square>;
+  TypeId (*volatile triangle)() = &TypeId::Of<Triangle>;
+  if (circle() == square() || circle() == triangle() ||
+      square() == triangle() || circle() != TypeIdOf<Circle>) {
+    std::cerr << "Distinct shape types share a TypeId!" << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// Small shapes live in the small buffer and stateless ones share one model.
+// Larger ones come from the heap, or from the memory resource they are given.
+static int ShapeMemoryDemo() {
+#ifndef NDEBUG
+  const std::size_t heap_allocations = Shape::HeapAllocations();
+#endif
+  std::vector<Shape> scene;
+  scene.emplace_back(Circle{5.0});
+  scene.emplace_back(Square{10.0});
+  scene.emplace_back(Triangle{10.0});
+  scene.emplace_back(Pyramid{});
+  scene.emplace_back(Bat{});
+  scene.emplace_back(Husky{});
+  scene.emplace_back(IndirectShape<Bat>{});
+  scene.emplace_back(IndirectShape<Circle>{Circle{5.0}});
+
+  // Every shape in the scene fits the small buffer. Neither constructing them
+  // nor copying and moving them around while the vector grows allocates.
+  std::vector<Shape> scene_copy(scene);
+  assert(Shape::HeapAllocations() == heap_allocations &&
+         "A small shape was allocated on the heap!");
+
+  // A Bat has no state at all, every Bat shape shares one model. Creating and
+  // copying them neither allocates nor copies anything.
+#ifndef NDEBUG
+  const std::size_t bat_clones = Shape::Clones();
+#endif
+  const Shape bat{Bat{}};
+  const Shape bat_copy{bat};
+  assert(&bat.as<Bat>() == &bat_copy.as<Bat>() && bat.HeapBytes() == 0);
+  assert(Shape::Clones() == bat_clones && Format(bat_copy) == Format(Bat{}));
+
+  // Moving a Shape is noexcept, so a growing vector moves its shapes. Not a
+  // single model, inline or on the heap, is cloned along the way.
+#ifndef NDEBUG
+  const std::size_t clones = Shape::Clones();
+#endif
+  std::vector<Shape> growing;
+  for (int i = 0; i < 100; ++i) {
+    growing.emplace_back(Circle{5.0});
+    growing.emplace_back(Polygon{2.0});
+  }
+  assert(Shape::Clones() == clones && "Growing the vector cloned a shape!");
+
+  // A frame whose large shapes all come from one fixed buffer, and so do their
+  // copies. Running out of it throws rather than falling back to the heap.
+  std::array<std::byte, 1024> frame_memory;
+  std::pmr::monotonic_buffer_resource frame_resource{
+      frame_memory.data(), frame_memory.size(), std::pmr::null_memory_resource()};
+  {
+    std::pmr::vector<Shape> frame(&frame_resource);
+    frame.emplace_back(Polygon{2.0});
+    frame.push_back(frame.front());
+    // A copy outside of the frame doesn't allocate from it, and so can't
+    // outlive it by accident.
+    const Shape polygon_copy{frame.back()};
+    assert(frame.back().get_allocator().resource() == &frame_resource &&
+           polygon_copy.get_allocator().resource() ==
+               std::pmr::new_delete_resource());
+    assert(Format(polygon_copy) == ShapeFormat(Polygon{2.0}));
+  }
+  frame_resource.release();
+
+  return 0;
+}
+
+// Shapes built, replaced and moved in place.
+static int ShapeEmplaceDemo() {
+  // Built right inside the Shape, without a temporary to copy from.
+  Shape in_place{std::in_place_type<Circle>, 5.0};
+  assert(in_place.as<Circle>().radius() == 5.0);
+  const Square& replaced = in_place.emplace<Square>(4.0);
+  assert(in_place.try_as<Square>() == &replaced);
+
+  // A replacement which fails to construct leaves an empty shape, not one
+  // which still claims to hold the square.
+  struct FailingGlyph {
+    operator std::string() const { throw std::runtime_error{"No glyph."}; }
+  };
+  try {
+    in_place.emplace<Stamp>(FailingGlyph{});
+  } catch (const std::runtime_error&) {
+  }
+  assert(!in_place.is<Square>() && !in_place.is<Stamp>());
+  in_place.emplace<Square>(4.0);
+
+  Shape stamp{std::in_place_type<Stamp>, "[#]"};
+  const Shape moved_stamp{std::move(stamp)};
+  assert(Format(moved_stamp) == "[#]" && Calculate(moved_stamp) == 3);
+
+  // A moved from shape is empty, it no longer claims to hold a circle.
+  Shape moved_from{Circle{5.0}};
+  Shape moved_to{std::move(moved_from)};
+  assert(moved_to.is<Circle>() && !moved_from.is<Circle>() &&
+         moved_from.try_as<Circle>() == nullptr);
+  moved_from = std::move(moved_to);
+  assert(moved_from.is<Circle>() && !moved_to.is<Circle>() &&
+         moved_to.try_as<Circle>() == nullptr);
+  const ShapeView empty_view{moved_to};
+  assert(empty_view.empty() && !empty_view.is<Circle>() &&
+         empty_view.try_as<Circle>() == nullptr);
+  TableShape table_from{Circle{5.0}};
+  const TableShape table_to{std::move(table_from)};
+  assert(table_to.is<Circle>() && !table_from.is<Circle>());
+
+  return 0;
+}
+
+// Glyphs in static storage, and rasters baked by the compiler, are handed out
+// without a copy.
+static int ShapeGlyphDemo() {
+  // A pyramid is a glyph in static storage, it can be drawn without a copy.
+  // The husky's glyph still gets the header of its CRTP base in front.
+  const Shape pyramid{Pyramid{}};
+  assert(pyramid.FormatView() == Pyramid::Glyph() &&
+         Format(pyramid) == Pyramid::Glyph());
+  const Shape husky_shape{Husky{}};
+  assert(!husky_shape.FormatView() &&
+         Format(husky_shape).starts_with("[X:0|Y:0]\n") &&
+         Format(husky_shape).ends_with(Glyph(Husky{})));
+
+  // A circle of radius 5 was rasterized by the compiler, the shape hands out
+  // the baked table itself. Other radii are rasterized at run time.
+  using BakedCircle = ShapeGlyphTable<Circle, 5.0>;
+  const Shape baked_circle{Circle{5.0}};
+  assert(baked_circle.FormatView()->data() == BakedCircle::glyph.data() &&
+         Format(baked_circle) == BakedCircle::glyph);
+  assert(!Shape{Circle{7.0}}.FormatView());
+
+  // The generic erasure is served from the same baked glyph.
+  const ErasedShape erased_circle{Circle{5.0}};
+  assert(Format(erased_circle) == BakedCircle::glyph);
+
+  return 0;
+}
+
+static int RenderCacheDemo() {
+  // Formatting the same circle again copies its cached raster.
+  const RenderCacheStats cache_before = RenderCache::Global().stats();
+  const std::string cached_circle = Format(Shape{Circle{7.0}});
+  assert(Format(Shape{Circle{7.0}}) == cached_circle &&
+         cached_circle == Format(Circle{7.0}));
+  assert(Format(Shape{Square{6.0}}) == Square{6.0}.Format());
+  assert(RenderCache::Global().stats().hits > cache_before.hits);
+
+  // A cache too small for two circles evicts the older one.
+  RenderCache small_cache{cached_circle.size() + 256};
+  std::string scratch;
+  for (double radius : {7.0, 8.0, 7.0}) {
+    const Circle c{radius};
+    small_cache.FormatTo(scratch, c, Hash(c), [&](std::string& raster) {
+      ShapeFormatTo(raster, c);
+    });
+  }
+  const RenderCacheStats small_stats = small_cache.stats();
+  assert(small_stats.misses == 3 && small_stats.evictions >= 1 &&
+         small_stats.bytes <= small_stats.capacity);
+
+  return 0;
+}
+
+// The whole scene appended into one frame. Clearing keeps the capacity, so
+// drawing the next frame doesn't allocate again.
+static int ShapeFormatToDemo() {
+  std::vector<Shape> shapes;
+  shapes.emplace_back(Circle{5.0});
+  shapes.emplace_back(Square{10.0});
+  shapes.emplace_back(Husky{});
+
+  std::string frame;
+  for (const auto& shape : shapes) {
+    FormatTo(frame, shape);
+  }
+  const std::size_t frame_size = frame.size();
+  frame.clear();
+  for (const auto& shape : shapes) {
+    FormatTo(frame, shape);
+  }
+  assert(frame.size() == frame_size && frame.capacity() >= frame_size);
+  assert(frame.starts_with(Format(shapes.front())));
+
+  return 0;
+}
+
+// The same shapes through the generic erasure. Only the storage policy tells
+// an owning shape from a view or a shared one.
+static int ErasedShapeDemo() {
+  std::vector<ErasedShape> erased_shapes{};
+  erased_shapes.emplace_back(Circle{5.0});
+  erased_shapes.emplace_back(Square{10.0});
+  erased_shapes.emplace_back(Husky{});
+
+  const Square square{10.0};
+  const ErasedShapeView square_view{square};
+  assert(square_view.is<Square>() && erased_shapes[1].is<Square>());
+  assert(Format(square_view) == Format(erased_shapes[1]));
+
+  // A moved from handle is empty, and so is anything made from it.
+  ErasedShape moved_circle{std::move(erased_shapes[0])};
+  ErasedShape moved_again{std::move(erased_shapes[0])};
+  assert(moved_circle.is<Circle>() && moved_again.empty() &&
+         !erased_shapes[0].is<Circle>());
+  erased_shapes[0] = std::move(moved_again);
+  erased_shapes[0] = std::move(moved_circle);
+
+  const Erased<SharedStorage, FormatOp, CalculateOp, PrintOp> husky{Husky{}};
+  const auto husky_copy = husky;
+  assert(&husky_copy.as<Husky>() == &husky.as<Husky>() &&
+         "Copies of a shared shape should share the husky!");
+
+  // Copy-on-write copies share the square until one of them is modified.
+  CowShape cow_square{Square{10.0}};
+  CowShape cow_copy = cow_square;
+  assert(&std::as_const(cow_copy).as<Square>() ==
+             &std::as_const(cow_square).as<Square>() &&
+         cow_square.storage().use_count() == 2);
+  Square& detached = cow_copy.as<Square>();
+  assert(&detached != &std::as_const(cow_square).as<Square>() &&
+         cow_square.storage().use_count() == 1 &&
+         "Modifying a copy should detach it!");
+
+  return 0;
+}
+
 static int AntonsSilverBullet() {
   Shape circle{Circle{5.0}};
   std::vector<Shape> shapes;
@@ -857,16 +2262,20 @@ static int AntonsSilverBullet() {
                    [](const Shape& shape) { return shape.is<Square>(); });
   if (square_loc != shapes.end()) {
     // I found it!
-    my_square = &shapes.back().as<Square>();
+    my_square = &square_loc->as<Square>();
   }
   assert(square_loc != shapes.end() && "I lost my square!");
   assert(std::distance(shapes.begin(), square_loc) == 1 && "I lost my square!");
+  assert(shapes[1].try_as<Square>() == my_square && "I lost my square!");
+  assert(shapes.back().try_as<Square>() == nullptr && "That's no square!");
 
   IndirectShape<Circle> indirect_circle{Circle{5.0}};
   shapes.push_back(indirect_circle);
 
   for (const auto& shape : shapes) {
+#if TYPE_ID_HAS_RTTI
     std::cout << "Drawing: " << shape.typeidx().name() << std::endl;
+#endif
     std::cout << Format(shape) << std::endl;
   }
 
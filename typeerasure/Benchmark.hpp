@@ -0,0 +1,452 @@
+// Micro benchmarks comparing the different ways of storing and dispatching to
+// a type erased Shape. Run them with `typeerasure --bench`, ideally from a
+// Release build, the Debug numbers are meaningless.
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <limits>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <thread>
+#include <typeinfo>
+#include <vector>
+#include "AntonsSilverBullet.hpp"
+#include "PackedShapeBuffer.hpp"
+#include "RenderCache.hpp"
+#include "ShapeArena.hpp"
+#include "ShapeCollection.hpp"
+#include "ShapeColumns.hpp"
+
+// Polygons whose heap models are recycled through a per type pool.
+struct SharedPoolPolygon : Polygon {
+  using Polygon::Polygon;
+};
+
+struct ThreadPoolPolygon : Polygon {
+  using Polygon::Polygon;
+};
+
+template <>
+inline constexpr ShapePool ShapePoolFor<SharedPoolPolygon> = ShapePool::Shared;
+
+template <>
+inline constexpr ShapePool ShapePoolFor<ThreadPoolPolygon> =
+    ShapePool::ThreadLocal;
+
+// Results are written here so the optimizer can't discard the measured work.
+static volatile long long benchmark_sink = 0;
+
+// Runs `body` a few times and returns the fastest run in nanoseconds per
+// element, which filters out most of the noise from the rest of the system.
+template <class Body>
+double MeasureNanosPerElement(std::size_t elements, Body&& body,
+                              int repetitions = 5) {
+  double best = std::numeric_limits<double>::max();
+  for (int i = 0; i < repetitions; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    body();
+    const auto stop = std::chrono::steady_clock::now();
+    const std::chrono::duration<double, std::nano> elapsed = stop - start;
+    best = std::min(best, elapsed.count() / elements);
+  }
+  return best;
+}
+
+// A scene of randomly interleaved circles, squares and triangles. The order is
+// random so the branch predictor can't learn the sequence of calls.
+template <class ShapeT>
+std::vector<ShapeT> MakeBenchmarkScene(std::size_t count) {
+  std::vector<ShapeT> scene;
+  scene.reserve(count);
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<int> kind{0, 2};
+  for (std::size_t i = 0; i < count; ++i) {
+    switch (kind(rng)) {
+      case 0:
+        scene.emplace_back(Circle{5.0});
+        break;
+      case 1:
+        scene.emplace_back(Square{10.0});
+        break;
+      default:
+        scene.emplace_back(Triangle{10.0});
+        break;
+    }
+  }
+  return scene;
+}
+
+template <class Scene>
+void CalculateAll(const Scene& scene) {
+  long long sum = 0;
+  for (const auto& shape : scene) {
+    sum += Calculate(shape);
+  }
+  benchmark_sink = sum;
+}
+
+// Compiler generated vtable of `Shape::Model<T>` against the hand rolled
+// `ShapeDispatch` table of `TableShape`.
+static void BenchmarkDispatch(std::size_t count) {
+  const auto shapes = MakeBenchmarkScene<Shape>(count);
+  const auto table_shapes = MakeBenchmarkScene<TableShape>(count);
+
+  std::cout << "Calculate, Shape::Model<T> vtable: "
+            << MeasureNanosPerElement(count, [&] { CalculateAll(shapes); })
+            << " ns/shape" << std::endl;
+  std::cout << "Calculate, ShapeDispatch table:    "
+            << MeasureNanosPerElement(count, [&] { CalculateAll(table_shapes); })
+            << " ns/shape" << std::endl;
+}
+
+// One virtual call per element against one inlined loop per type.
+static void BenchmarkTypeBuckets(std::size_t count) {
+  const auto shapes = MakeBenchmarkScene<Shape>(count);
+  ShapeCollection collection;
+  for (const auto& shape : shapes) {
+    if (const Circle* circle = shape.try_as<Circle>()) {
+      collection.insert(*circle);
+    } else if (const Square* square = shape.try_as<Square>()) {
+      collection.insert(*square);
+    } else {
+      collection.insert(shape.as<Triangle>());
+    }
+  }
+
+  std::cout << "Calculate, std::vector<Shape>:      "
+            << MeasureNanosPerElement(count, [&] { CalculateAll(shapes); })
+            << " ns/shape" << std::endl;
+  std::cout << "Calculate, ShapeCollection buckets: "
+            << MeasureNanosPerElement(count, [&] {
+                 long long sum = 0;
+                 collection.for_each<Circle, Square, Triangle>(
+                     [&](const auto& shape) { sum += ShapeCalculate(shape); });
+                 benchmark_sink = sum;
+               })
+            << " ns/shape" << std::endl;
+}
+
+// Shapes scattered over the small buffers and heap models of a vector against
+// shapes packed back to back, both in the same order.
+static void BenchmarkPackedBuffer(std::size_t count) {
+  const auto shapes = MakeBenchmarkScene<Shape>(count);
+  PackedShapeBuffer packed;
+  for (const auto& shape : shapes) {
+    if (const Circle* circle = shape.try_as<Circle>()) {
+      packed.push_back(*circle);
+    } else if (const Square* square = shape.try_as<Square>()) {
+      packed.push_back(*square);
+    } else {
+      packed.push_back(shape.as<Triangle>());
+    }
+  }
+
+  std::cout << "Calculate, std::vector<Shape>:      "
+            << MeasureNanosPerElement(count, [&] { CalculateAll(shapes); })
+            << " ns/shape" << std::endl;
+  std::cout << "Calculate, PackedShapeBuffer:       "
+            << MeasureNanosPerElement(count, [&] { CalculateAll(packed); })
+            << " ns/shape" << std::endl;
+}
+
+// A filter pass over a scene, which checks the type of every element.
+template <class Scene>
+void CountCircles(const Scene& scene) {
+  long long circles = 0;
+  for (const auto& shape : scene) {
+    circles += shape.template is<Circle>();
+  }
+  benchmark_sink = circles;
+}
+
+#if TYPE_ID_HAS_RTTI
+// The check `is<T>()` replaced, a virtual call for the `std::type_index` of the
+// model compared against `typeid(Circle)`.
+static void CountCirclesByTypeid(const std::vector<Shape>& scene) {
+  long long circles = 0;
+  for (const auto& shape : scene) {
+    circles += shape.typeidx() == typeid(Circle);
+  }
+  benchmark_sink = circles;
+}
+#endif
+
+// `is<T>()` compares the `TypeId` kept in the handle or the table, instead of
+// making a virtual call and comparing `std::type_info` objects.
+static void BenchmarkTypeChecks(std::size_t count) {
+  const auto shapes = MakeBenchmarkScene<Shape>(count);
+  const auto table_shapes = MakeBenchmarkScene<TableShape>(count);
+
+#if TYPE_ID_HAS_RTTI
+  std::cout << "typeidx() == typeid(Circle):       "
+            << MeasureNanosPerElement(count,
+                                      [&] { CountCirclesByTypeid(shapes); })
+            << " ns/shape" << std::endl;
+#endif
+  std::cout << "is<Circle>, Shape handle:          "
+            << MeasureNanosPerElement(count, [&] { CountCircles(shapes); })
+            << " ns/shape" << std::endl;
+  std::cout << "is<Circle>, ShapeDispatch table:   "
+            << MeasureNanosPerElement(count, [&] { CountCircles(table_shapes); })
+            << " ns/shape" << std::endl;
+}
+
+// Deep copies of every model against copy-on-write copies, which only bump a
+// reference count.
+static void BenchmarkSceneCopies(std::size_t count) {
+  const auto shapes = MakeBenchmarkScene<Shape>(count);
+  const auto cow_shapes = MakeBenchmarkScene<CowShape>(count);
+
+  std::cout << "Copy, std::vector<Shape>:          "
+            << MeasureNanosPerElement(count, [&] {
+                 std::vector<Shape> copy(shapes);
+                 benchmark_sink = copy.size();
+               })
+            << " ns/shape" << std::endl;
+  std::cout << "Copy, std::vector<CowShape>:       "
+            << MeasureNanosPerElement(count, [&] {
+                 std::vector<CowShape> copy(cow_shapes);
+                 benchmark_sink = copy.size();
+               })
+            << " ns/shape" << std::endl;
+}
+
+// Builds and tears down a frame of shapes too large for the small buffer, with
+// their models allocated from the global heap, a monotonic buffer which is
+// released once per frame, and a pool.
+static void BenchmarkMemoryResources(std::size_t count) {
+  auto frame = [count](std::pmr::memory_resource* resource) {
+    std::pmr::vector<Shape> shapes(resource);
+    shapes.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      shapes.emplace_back(Polygon{static_cast<double>(i % 10)});
+    }
+    CalculateAll(shapes);
+  };
+  std::pmr::monotonic_buffer_resource monotonic;
+  std::pmr::unsynchronized_pool_resource pool;
+
+  std::cout << "Frame, new/delete:                 "
+            << MeasureNanosPerElement(
+                   count, [&] { frame(std::pmr::new_delete_resource()); })
+            << " ns/shape" << std::endl;
+  std::cout << "Frame, monotonic_buffer_resource:  "
+            << MeasureNanosPerElement(count,
+                                      [&] {
+                                        frame(&monotonic);
+                                        monotonic.release();
+                                      })
+            << " ns/shape" << std::endl;
+  std::cout << "Frame, unsynchronized_pool:        "
+            << MeasureNanosPerElement(count, [&] { frame(&pool); })
+            << " ns/shape" << std::endl;
+}
+
+// Builds and tears down a frame of heap allocated models, with and without
+// recycling them through a pool.
+template <class PolygonT>
+static double MeasurePolygonFrames(std::size_t count) {
+  return MeasureNanosPerElement(count, [count] {
+    std::vector<Shape> shapes;
+    shapes.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+      shapes.emplace_back(PolygonT{static_cast<double>(i % 10)});
+    }
+    CalculateAll(shapes);
+  });
+}
+
+static void BenchmarkModelPools(std::size_t count) {
+  std::cout << "Frame, new/delete models:          "
+            << MeasurePolygonFrames<Polygon>(count) << " ns/shape"
+            << std::endl;
+  std::cout << "Frame, shared model pool:          "
+            << MeasurePolygonFrames<SharedPoolPolygon>(count) << " ns/shape"
+            << std::endl;
+  std::cout << "Frame, thread local model pool:    "
+            << MeasurePolygonFrames<ThreadPoolPolygon>(count) << " ns/shape"
+            << std::endl;
+
+  const PoolStats stats = Shape::ModelPoolStats<ThreadPoolPolygon>();
+  std::cout << "Thread local model pool:           " << stats.hits
+            << " hits, " << stats.misses << " misses, " << stats.slabs
+            << " slabs" << std::endl;
+}
+
+// Heap models visited in a random order of addresses, as left behind by hours
+// of churn, against the same models compacted into traversal order.
+static void BenchmarkCompaction(std::size_t count) {
+  // Declared first, the arena has to outlive the shapes.
+  ShapeArena arena;
+  std::vector<Shape> shapes;
+  shapes.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    shapes.emplace_back(Polygon{static_cast<double>(i % 10)});
+  }
+  std::shuffle(shapes.begin(), shapes.end(), std::mt19937{42});
+
+  std::cout << "Calculate, shuffled heap models:   "
+            << MeasureNanosPerElement(count, [&] { CalculateAll(shapes); })
+            << " ns/shape" << std::endl;
+  arena = compact(shapes);
+  std::cout << "Calculate, compacted heap models:  "
+            << MeasureNanosPerElement(count, [&] { CalculateAll(shapes); })
+            << " ns/shape" << std::endl;
+}
+
+// The area of every shape, asked one erased shape at a time against one
+// vectorized kernel per column of parameters.
+static void BenchmarkColumns(std::size_t count) {
+  const auto shapes = MakeBenchmarkScene<Shape>(count);
+  ShapeCollection collection;
+  for (const auto& shape : shapes) {
+    if (const Circle* circle = shape.try_as<Circle>()) {
+      collection.insert(*circle);
+    } else if (const Square* square = shape.try_as<Square>()) {
+      collection.insert(*square);
+    } else {
+      collection.insert(shape.as<Triangle>());
+    }
+  }
+  std::vector<double> areas(count);
+
+  std::cout << "Area, std::vector<Shape> views:    "
+            << MeasureNanosPerElement(count,
+                                      [&] {
+                                        for (std::size_t i = 0; i < count;
+                                             ++i) {
+                                          areas[i] = *Area(shapes[i]);
+                                        }
+                                        benchmark_sink = areas.back();
+                                      })
+            << " ns/shape" << std::endl;
+  std::cout << "Area, column kernels:              "
+            << MeasureNanosPerElement(count,
+                                      [&] {
+                                        areas = Areas(collection);
+                                        benchmark_sink = areas.back();
+                                      })
+            << " ns/shape" << std::endl;
+}
+
+// A scene of circles, squares and triangles of a few sizes which aren't baked,
+// so every shape is either rendered or served from the render cache.
+static std::vector<Shape> MakeRenderScene(std::size_t count) {
+  std::vector<Shape> scene;
+  scene.reserve(count);
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<int> kind{0, 2};
+  std::uniform_int_distribution<int> sizes{6, 9};
+  for (std::size_t i = 0; i < count; ++i) {
+    const double size = sizes(rng);
+    switch (kind(rng)) {
+      case 0:
+        scene.emplace_back(Circle{size});
+        break;
+      case 1:
+        scene.emplace_back(Square{size});
+        break;
+      default:
+        scene.emplace_back(Triangle{size});
+        break;
+    }
+  }
+  return scene;
+}
+
+// Formats shapes `first` to `last` of the scene into one reused string, either
+// through `Format`, which consults the cache, or by rasterizing every shape as
+// `Format` did before there was a cache.
+template <bool Cached>
+void FormatRange(const std::vector<Shape>& scene, std::size_t first,
+                 std::size_t last) {
+  std::string out;
+  std::size_t bytes = 0;
+  for (std::size_t i = first; i < last; ++i) {
+    out.clear();
+    if constexpr (Cached) {
+      FormatTo(out, scene[i]);
+    } else if (const Circle* circle = scene[i].try_as<Circle>()) {
+      ShapeFormatTo(out, *circle);
+    } else if (const Square* square = scene[i].try_as<Square>()) {
+      ShapeFormatTo(out, *square);
+    } else {
+      ShapeFormatTo(out, scene[i].as<Triangle>());
+    }
+    bytes += out.size();
+  }
+  benchmark_sink = bytes;
+}
+
+// The scene split evenly over `threads` threads, which all share the one
+// global render cache.
+template <bool Cached>
+void FormatOnThreads(const std::vector<Shape>& scene, unsigned threads) {
+  std::vector<std::thread> workers;
+  const std::size_t slice = scene.size() / threads;
+  for (unsigned i = 0; i < threads; ++i) {
+    const std::size_t last = i + 1 == threads ? scene.size() : (i + 1) * slice;
+    workers.emplace_back([&scene, first = i * slice, last] {
+      FormatRange<Cached>(scene, first, last);
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+}
+
+// Rasterizing every shape against copying the raster out of the render cache,
+// and how both scale when threads contend for the cache's lock.
+static void BenchmarkRenderCache(std::size_t count) {
+  const std::vector<Shape> shapes = MakeRenderScene(count);
+  // Warmed up, so only the hits are measured.
+  FormatRange<true>(shapes, 0, shapes.size());
+  const RenderCacheStats before = RenderCache::Global().stats();
+
+  std::cout << "Format, rasterized:                "
+            << MeasureNanosPerElement(
+                   count, [&] { FormatRange<false>(shapes, 0, count); })
+            << " ns/shape" << std::endl;
+  std::cout << "Format, render cache:              "
+            << MeasureNanosPerElement(
+                   count, [&] { FormatRange<true>(shapes, 0, count); })
+            << " ns/shape" << std::endl;
+
+  const unsigned most = std::max(std::thread::hardware_concurrency(), 2u);
+  for (unsigned threads = 2; threads <= most; threads *= 2) {
+    std::cout << "Format, rasterized, " << threads << " threads:    "
+              << MeasureNanosPerElement(
+                     count, [&] { FormatOnThreads<false>(shapes, threads); })
+              << " ns/shape" << std::endl;
+    std::cout << "Format, render cache, " << threads << " threads:  "
+              << MeasureNanosPerElement(
+                     count, [&] { FormatOnThreads<true>(shapes, threads); })
+              << " ns/shape" << std::endl;
+  }
+
+  const RenderCacheStats stats = RenderCache::Global().stats();
+  std::cout << "Render cache:                      "
+            << stats.hits - before.hits << " hits, "
+            << stats.misses - before.misses << " misses, " << stats.entries
+            << " rasters" << std::endl;
+}
+
+static int ShapeBenchmarks() {
+  constexpr std::size_t count = 1'000'000;
+  BenchmarkDispatch(count);
+  BenchmarkTypeBuckets(count);
+  BenchmarkPackedBuffer(count);
+  BenchmarkTypeChecks(count);
+  BenchmarkSceneCopies(count);
+  BenchmarkMemoryResources(count);
+  BenchmarkModelPools(count);
+  BenchmarkCompaction(count);
+  BenchmarkColumns(count);
+  // Formatting is slower than any other benchmark per shape.
+  BenchmarkRenderCache(count / 10);
+  return 0;
+}
@@ -6,7 +6,9 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
+#include "Relocation.hpp"
 
 // Type Erasure Sample Code.
 //
@@ -326,14 +328,14 @@ class Shape {
 
   constexpr Shape(const Shape& s) : pimpl_{s.pimpl_->clone()} {}
 
-  constexpr Shape(Shape&& s) : pimpl_{std::move(s.pimpl_)} {}
+  constexpr Shape(Shape&& s) noexcept : pimpl_{std::move(s.pimpl_)} {}
 
   constexpr Shape& operator=(const Shape& s) {
     pimpl_ = s.pimpl_->clone();
     return *this;
   }
 
-  constexpr Shape& operator=(Shape&& s) {
+  constexpr Shape& operator=(Shape&& s) noexcept {
     pimpl_ = std::move(s.pimpl_);
     return *this;
   }
@@ -363,6 +365,12 @@ class Shape {
   void print(std::ostream& os) const { os << *this; }
 };
 
+// A lone std::unique_ptr, see Relocation.hpp.
+static_assert(IsPointerSizedHandle<Shape>);
+
+template <>
+inline constexpr bool IsTriviallyRelocatable<Shape> = true;
+
 class ShapeView {
   // NOTE: Definition of the explicit specialization has to appear separately
   // later outside of class `Shape`, otherwise it results in error such as:
@@ -471,14 +479,14 @@ class ShapeView {
 
   constexpr ShapeView(const ShapeView& s) : pimpl_{s.pimpl_->clone()} {}
 
-  constexpr ShapeView(ShapeView&& s) : pimpl_{std::move(s.pimpl_)} {}
+  constexpr ShapeView(ShapeView&& s) noexcept : pimpl_{std::move(s.pimpl_)} {}
 
   constexpr ShapeView& operator=(const ShapeView& s) {
     pimpl_ = s.pimpl_->clone();
     return *this;
   }
 
-  constexpr ShapeView& operator=(ShapeView&& s) {
+  constexpr ShapeView& operator=(ShapeView&& s) noexcept {
     pimpl_ = std::move(s.pimpl_);
     return *this;
   }
@@ -508,6 +516,12 @@ class ShapeView {
   void print(std::ostream& os) const { os << *this; }
 };
 
+// A lone std::unique_ptr, see Relocation.hpp.
+static_assert(IsPointerSizedHandle<ShapeView>);
+
+template <>
+inline constexpr bool IsTriviallyRelocatable<ShapeView> = true;
+
 template <>
 void serialize(const Shape& shape) {
   shape.pimpl_->serialize();
@@ -6,10 +6,12 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <list>
 #include <typeindex>
 #include <cassert>
+#include "Relocation.hpp"
 // Type Erasure Sample Code.
 //
 // Implementation of Klaus Iglberger's C++ Type Erasure Design Pattern.
@@ -360,14 +362,14 @@ class Shape {
 
   Shape(const Shape& s) : pimpl_{s.pimpl_->clone()} {}
 
-  Shape(Shape&& s) : pimpl_{std::move(s.pimpl_)} {}
+  Shape(Shape&& s) noexcept : pimpl_{std::move(s.pimpl_)} {}
 
   Shape& operator=(const Shape& s) {
     pimpl_ = s.pimpl_->clone();
     return *this;
   }
 
-  Shape& operator=(Shape&& s) {
+  Shape& operator=(Shape&& s) noexcept {
     pimpl_ = std::move(s.pimpl_);
     return *this;
   }
@@ -398,6 +400,12 @@ class Shape {
   void print(std::ostream& os) const { os << *this; }
 };
 
+// A lone std::unique_ptr, see Relocation.hpp.
+static_assert(IsPointerSizedHandle<Shape>);
+
+template <>
+inline constexpr bool IsTriviallyRelocatable<Shape> = true;
+
 template <>
 void serialize(const Shape& shape) {
   shape.pimpl_->serialize();
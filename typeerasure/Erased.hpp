@@ -0,0 +1,559 @@
+// Generic Type Erasure.
+//
+// `Shape`, `ShapeView` and `TableShape` each spell out their own
+// `Interface`/`Model` pair or dispatch table for the very same operations.
+// Changing how one of them stores its object means rewriting the class.
+//
+// `Erased<Storage, Ops...>` generates the dispatch table for a list of
+// operations, and leaves ownership of the object to a storage policy:
+// - `HeapStorage`: always on the heap, like the original `Shape`.
+// - `SmallBufferStorage<Size>`: inline when it fits, otherwise on the heap.
+// - `InlineStorage<Size>`: always inline, too large types don't compile.
+// - `SharedStorage`: an immutable object shared between all copies.
+// - `CopyOnWriteStorage`: shared between copies until one of them is modified.
+// - `ViewStorage`: a non-owning reference, like `ShapeView`.
+//
+// An operation is a type with a `Signature` and a static `call` template which
+// performs it on a concrete `T`:
+/*
+  struct FormatOp {
+    using Signature = std::string();
+
+    template <class T>
+    static constexpr std::string call(const T& object) {
+      return ShapeFormat(object);
+    }
+  };
+*/
+
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include "TypeId.hpp"
+
+template <class Op, class Signature = typename Op::Signature>
+struct ErasedOp;
+
+template <class Op, class R, class... Args>
+struct ErasedOp<Op, R(Args...)> {
+  using Pointer = R (*)(const void* object, Args... args);
+
+  template <class T>
+  static constexpr R thunk(const void* object, Args... args) {
+    return Op::call(*std::launder(static_cast<const T*>(object)),
+                    std::forward<Args>(args)...);
+  }
+};
+
+template <class Op, class... Ops>
+inline constexpr std::size_t ErasedOpIndex = 0;
+
+template <class Op, class First, class... Rest>
+inline constexpr std::size_t ErasedOpIndex<Op, First, Rest...> =
+    std::is_same_v<Op, First> ? 0 : 1 + ErasedOpIndex<Op, Rest...>;
+
+template <class T>
+inline constexpr bool IsInPlaceType = false;
+
+template <class T>
+inline constexpr bool IsInPlaceType<std::in_place_type_t<T>> = true;
+
+// A handle of a move only type can be moved, but whether it is copyable is only
+// known at runtime. Copying one ends up here.
+[[noreturn]] inline void ThrowCopyOfMoveOnly() {
+  throw std::logic_error{"Copying a type erased move only object."};
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Storage Policies */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Every policy provides:
+// - `Operations`, the per type function pointers it needs to copy, move and
+//   destroy what it stores, and `operations<T>()` to fill them in.
+// - A constructor from `std::in_place_type<T>` and the constructor arguments.
+// - A default constructor, which leaves it empty. That's what's left behind by
+//   a moved from handle, nothing but another empty storage is made from it.
+// - Copy and move constructors which are handed the `Operations` of the type.
+// - `destroy(operations)` and `get()`, returning the address of the object.
+// - `IsTrivial`, true when the policy can be copied and dropped bitwise.
+// Policies which allow the object to be modified also provide
+// `get_mutable(operations)`.
+
+struct HeapStorage {
+  struct Operations {
+    void* (*clone)(const void* object);
+    void (*destroy)(void* object) noexcept;
+  };
+
+  template <class T>
+  static constexpr Operations operations() {
+    return {[](const void* object) -> void* {
+              if constexpr (std::is_copy_constructible_v<T>) {
+                return new T(*static_cast<const T*>(object));
+              } else {
+                ThrowCopyOfMoveOnly();
+              }
+            },
+            [](void* object) noexcept { delete static_cast<T*>(object); }};
+  }
+
+  static constexpr bool IsTrivial = false;
+
+  void* object_{nullptr};
+
+  constexpr HeapStorage() = default;
+
+  template <class T, class... Args>
+  constexpr HeapStorage(std::in_place_type_t<T>, Args&&... args)
+      : object_{new T(std::forward<Args>(args)...)} {}
+
+  constexpr HeapStorage(const HeapStorage& other, const Operations& ops)
+      : object_{ops.clone(other.object_)} {}
+
+  constexpr HeapStorage(HeapStorage&& other, const Operations&) noexcept
+      : object_{std::exchange(other.object_, nullptr)} {}
+
+  constexpr void destroy(const Operations& ops) noexcept {
+    ops.destroy(object_);
+  }
+
+  constexpr const void* get() const { return object_; }
+
+  constexpr void* get_mutable(const Operations&) { return object_; }
+};
+
+template <std::size_t Size, std::size_t Align = alignof(std::max_align_t)>
+struct SmallBufferStorage {
+  template <class T>
+  static constexpr bool IsInline = sizeof(T) <= Size && alignof(T) <= Align &&
+                                   std::is_nothrow_move_constructible_v<T>;
+
+  struct Operations {
+    // Copies the object into `buffer` when it fits, otherwise onto the heap.
+    void* (*clone)(const void* object, std::byte* buffer);
+    // Moves an inline object into `buffer`. A heap object is returned as is.
+    void* (*move)(void* object, std::byte* buffer) noexcept;
+    void (*destroy)(void* object) noexcept;
+  };
+
+  template <class T>
+  static void* Create(std::byte* buffer, auto&&... args) {
+    if constexpr (IsInline<T>) {
+      return ::new (buffer) T(std::forward<decltype(args)>(args)...);
+    } else {
+      return new T(std::forward<decltype(args)>(args)...);
+    }
+  }
+
+  template <class T>
+  static constexpr Operations operations() {
+    return {[](const void* object, std::byte* buffer) -> void* {
+              if constexpr (std::is_copy_constructible_v<T>) {
+                return Create<T>(buffer, *static_cast<const T*>(object));
+              } else {
+                ThrowCopyOfMoveOnly();
+              }
+            },
+            [](void* object, std::byte* buffer) noexcept -> void* {
+              if constexpr (IsInline<T>) {
+                void* moved =
+                    ::new (buffer) T(std::move(*static_cast<T*>(object)));
+                std::destroy_at(static_cast<T*>(object));
+                return moved;
+              } else {
+                return object;
+              }
+            },
+            [](void* object) noexcept {
+              if constexpr (IsInline<T>) {
+                std::destroy_at(static_cast<T*>(object));
+              } else {
+                delete static_cast<T*>(object);
+              }
+            }};
+  }
+
+  static constexpr bool IsTrivial = false;
+
+  // Points into `buffer_` for inline objects, otherwise owns a heap object.
+  void* object_{nullptr};
+  alignas(Align) std::byte buffer_[Size];
+
+  SmallBufferStorage() = default;
+
+  template <class T, class... Args>
+  SmallBufferStorage(std::in_place_type_t<T>, Args&&... args)
+      : object_{Create<T>(buffer_, std::forward<Args>(args)...)} {}
+
+  SmallBufferStorage(const SmallBufferStorage& other, const Operations& ops)
+      : object_{ops.clone(other.object_, buffer_)} {}
+
+  SmallBufferStorage(SmallBufferStorage&& other,
+                     const Operations& ops) noexcept
+      : object_{ops.move(std::exchange(other.object_, nullptr), buffer_)} {}
+
+  void destroy(const Operations& ops) noexcept { ops.destroy(object_); }
+
+  const void* get() const { return object_; }
+
+  void* get_mutable(const Operations&) { return object_; }
+};
+
+template <std::size_t Size, std::size_t Align = alignof(std::max_align_t)>
+struct InlineStorage {
+  struct Operations {
+    void (*copy)(const void* from, void* to);
+    void (*move)(void* from, void* to) noexcept;
+    void (*destroy)(void* object) noexcept;
+  };
+
+  template <class T>
+  static constexpr Operations operations() {
+    return {[](const void* from, void* to) {
+              if constexpr (std::is_copy_constructible_v<T>) {
+                ::new (to) T(*std::launder(static_cast<const T*>(from)));
+              } else {
+                ThrowCopyOfMoveOnly();
+              }
+            },
+            [](void* from, void* to) noexcept {
+              T* object = std::launder(static_cast<T*>(from));
+              ::new (to) T(std::move(*object));
+              std::destroy_at(object);
+            },
+            [](void* object) noexcept {
+              std::destroy_at(std::launder(static_cast<T*>(object)));
+            }};
+  }
+
+  static constexpr bool IsTrivial = false;
+
+  alignas(Align) std::byte buffer_[Size];
+
+  InlineStorage() = default;
+
+  template <class T, class... Args>
+  InlineStorage(std::in_place_type_t<T>, Args&&... args) {
+    static_assert(sizeof(T) <= Size && alignof(T) <= Align,
+                  "Type does not fit the inline storage.");
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+                  "Inline storage requires a nothrow movable type.");
+    ::new (buffer_) T(std::forward<Args>(args)...);
+  }
+
+  InlineStorage(const InlineStorage& other, const Operations& ops) {
+    ops.copy(other.buffer_, buffer_);
+  }
+
+  InlineStorage(InlineStorage&& other, const Operations& ops) noexcept {
+    ops.move(other.buffer_, buffer_);
+  }
+
+  void destroy(const Operations& ops) noexcept { ops.destroy(buffer_); }
+
+  const void* get() const { return buffer_; }
+
+  void* get_mutable(const Operations&) { return buffer_; }
+};
+
+// Copies share one immutable object through an atomic reference count, so
+// copying is cheap no matter how large the object is.
+struct SharedStorage {
+  struct Operations {};
+
+  template <class T>
+  static constexpr Operations operations() {
+    return {};
+  }
+
+  static constexpr bool IsTrivial = false;
+
+  std::shared_ptr<const void> object_;
+
+  SharedStorage() = default;
+
+  template <class T, class... Args>
+  SharedStorage(std::in_place_type_t<T>, Args&&... args)
+      : object_{std::make_shared<const T>(std::forward<Args>(args)...)} {}
+
+  SharedStorage(const SharedStorage& other, const Operations&)
+      : object_{other.object_} {}
+
+  SharedStorage(SharedStorage&& other, const Operations&) noexcept
+      : object_{std::move(other.object_)} {}
+
+  void destroy(const Operations&) noexcept { object_.reset(); }
+
+  const void* get() const { return object_.get(); }
+};
+
+// Copies share one object through an atomic reference count, like with
+// `SharedStorage`. Modifying it through `get_mutable()` first gives the handle
+// its own copy, unless it's the only owner. Copying a handle is then cheap, and
+// only the copies which are actually modified pay for a clone.
+struct CopyOnWriteStorage {
+  struct Header {
+    std::atomic<std::size_t> count{1};
+  };
+
+  template <class T>
+  struct Block : Header {
+    T object;
+
+    template <class... Args>
+    explicit Block(Args&&... args) : object(std::forward<Args>(args)...) {}
+  };
+
+  struct Operations {
+    // A new block, owned by the caller, holding a copy of the object.
+    Header* (*clone)(const Header* block);
+    void* (*object)(Header* block);
+    void (*destroy)(Header* block) noexcept;
+  };
+
+  template <class T>
+  static constexpr Operations operations() {
+    return {[](const Header* block) -> Header* {
+              if constexpr (std::is_copy_constructible_v<T>) {
+                return new Block<T>(static_cast<const Block<T>*>(block)->object);
+              } else {
+                ThrowCopyOfMoveOnly();
+              }
+            },
+            [](Header* block) -> void* {
+              return &static_cast<Block<T>*>(block)->object;
+            },
+            [](Header* block) noexcept { delete static_cast<Block<T>*>(block); }};
+  }
+
+  static constexpr bool IsTrivial = false;
+
+  Header* block_{nullptr};
+  // Cached address of the object inside `block_`.
+  void* object_{nullptr};
+
+  CopyOnWriteStorage() = default;
+
+  template <class T, class... Args>
+  CopyOnWriteStorage(std::in_place_type_t<T>, Args&&... args) {
+    Block<T>* block = new Block<T>(std::forward<Args>(args)...);
+    block_ = block;
+    object_ = &block->object;
+  }
+
+  CopyOnWriteStorage(const CopyOnWriteStorage& other, const Operations&)
+      : block_{other.block_}, object_{other.object_} {
+    block_->count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  CopyOnWriteStorage(CopyOnWriteStorage&& other, const Operations&) noexcept
+      : block_{std::exchange(other.block_, nullptr)},
+        object_{std::exchange(other.object_, nullptr)} {}
+
+  void destroy(const Operations& ops) noexcept {
+    if (block_ && block_->count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      ops.destroy(block_);
+    }
+  }
+
+  const void* get() const { return object_; }
+
+  // Detaches from the other copies before handing out the object.
+  void* get_mutable(const Operations& ops) {
+    if (block_->count.load(std::memory_order_acquire) != 1) {
+      Header* copy = ops.clone(block_);
+      destroy(ops);
+      block_ = copy;
+      object_ = ops.object(copy);
+    }
+    return object_;
+  }
+
+  // Number of handles sharing the object, zero for an empty storage.
+  std::size_t use_count() const {
+    return block_ ? block_->count.load(std::memory_order_relaxed) : 0;
+  }
+};
+
+// Does not own the object, the caller keeps it alive.
+struct ViewStorage {
+  struct Operations {};
+
+  template <class T>
+  static constexpr Operations operations() {
+    return {};
+  }
+
+  static constexpr bool IsTrivial = true;
+
+  const void* object_{nullptr};
+
+  constexpr ViewStorage() = default;
+
+  template <class T>
+  constexpr ViewStorage(std::in_place_type_t<T>, const T& object)
+      : object_{&object} {}
+
+  // A view of a temporary would dangle right away.
+  template <class T>
+  ViewStorage(std::in_place_type_t<T>, const T&& object) = delete;
+
+  constexpr void destroy(const Operations&) noexcept {}
+
+  constexpr const void* get() const { return object_; }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Generic Type Erased Class */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+template <class Storage, class... Ops>
+class Erased {
+  struct Table {
+    typename Storage::Operations storage;
+    std::tuple<typename ErasedOp<Ops>::Pointer...> ops;
+    TypeId id;
+    const std::type_info* type;
+  };
+
+  template <class T>
+  static constexpr Table TableFor{Storage::template operations<T>(),
+                                  {&ErasedOp<Ops>::template thunk<T>...},
+                                  TypeIdOf<T>,
+                                  TypeInfoOf<T>()};
+
+  const Table* table_{nullptr};
+  Storage storage_;
+
+ public:
+  template <class T>
+    requires(!std::is_same_v<std::remove_cvref_t<T>, Erased> &&
+             !IsInPlaceType<std::remove_cvref_t<T>>)
+  constexpr Erased(T&& x)
+      : table_{&TableFor<std::remove_cvref_t<T>>},
+        storage_{std::in_place_type<std::remove_cvref_t<T>>,
+                 std::forward<T>(x)} {}
+
+  template <class T, class... Args>
+  constexpr explicit Erased(std::in_place_type_t<T> type, Args&&... args)
+      : table_{&TableFor<T>}, storage_{type, std::forward<Args>(args)...} {}
+
+  constexpr Erased(const Erased& other)
+    requires Storage::IsTrivial
+  = default;
+
+  // A handle which was moved from is empty, copying or moving it yields
+  // another empty handle.
+  constexpr Erased(const Erased& other)
+      : table_{other.table_},
+        storage_{table_ ? Storage{other.storage_, table_->storage}
+                        : Storage{}} {}
+
+  constexpr Erased(Erased&& other) noexcept
+    requires Storage::IsTrivial
+  = default;
+
+  constexpr Erased(Erased&& other) noexcept
+      : table_{std::exchange(other.table_, nullptr)},
+        storage_{table_ ? Storage{std::move(other.storage_), table_->storage}
+                        : Storage{}} {}
+
+  constexpr ~Erased()
+    requires Storage::IsTrivial
+  = default;
+
+  constexpr ~Erased() {
+    if (table_) storage_.destroy(table_->storage);
+  }
+
+  constexpr Erased& operator=(const Erased& other)
+    requires Storage::IsTrivial
+  = default;
+
+  constexpr Erased& operator=(const Erased& other) {
+    if (this != &other) {
+      Erased copy{other};
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+
+  constexpr Erased& operator=(Erased&& other) noexcept
+    requires Storage::IsTrivial
+  = default;
+
+  constexpr Erased& operator=(Erased&& other) noexcept {
+    if (this != &other) {
+      std::destroy_at(this);
+      std::construct_at(this, std::move(other));
+    }
+    return *this;
+  }
+
+  // Performs the operation `Op` on the erased object.
+  template <class Op, class... Args>
+  constexpr decltype(auto) call(Args&&... args) const {
+    static_assert((std::is_same_v<Op, Ops> || ...),
+                  "Op is not one of the erased operations.");
+    return std::get<ErasedOpIndex<Op, Ops...>>(table_->ops)(
+        storage_.get(), std::forward<Args>(args)...);
+  }
+
+  constexpr TypeId id() const { return table_->id; }
+
+#if TYPE_ID_HAS_RTTI
+  constexpr const std::type_info& type() const { return *table_->type; }
+#endif
+
+  // False for an empty handle.
+  template <class T>
+  constexpr bool is() const {
+    return table_ && table_->id == TypeIdOf<T>;
+  }
+
+  constexpr bool empty() const { return table_ == nullptr; }
+
+  // Unchecked in release builds, the caller must know the object is a `T`.
+  template <class T>
+  constexpr const T& as() const {
+    assert(is<T>() && "The erased object is not a T!");
+    return *std::launder(static_cast<const T*>(storage_.get()));
+  }
+
+  // The object if it is a `T`, otherwise nullptr.
+  template <class T>
+  constexpr const T* try_as() const {
+    return is<T>() ? std::launder(static_cast<const T*>(storage_.get()))
+                   : nullptr;
+  }
+
+  // Mutable access, only for policies which allow modifying the object. A
+  // copy-on-write handle stops sharing the object with its copies first.
+  template <class T>
+    requires requires(Storage& storage, const Table& table) {
+      storage.get_mutable(table.storage);
+    }
+  constexpr T& as() {
+    assert(is<T>() && "The erased object is not a T!");
+    return *std::launder(static_cast<T*>(storage_.get_mutable(table_->storage)));
+  }
+
+  template <class T>
+    requires requires(Storage& storage, const Table& table) {
+      storage.get_mutable(table.storage);
+    }
+  constexpr T* try_as() {
+    return is<T>() ? std::launder(static_cast<T*>(
+                         storage_.get_mutable(table_->storage)))
+                   : nullptr;
+  }
+
+  constexpr const Storage& storage() const { return storage_; }
+};
@@ -11,8 +11,10 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <typeindex>
 #include <vector>
+#include "Relocation.hpp"
 
 template <typename T>
 constexpr T absolute(T value) {
@@ -306,6 +308,12 @@ class Shape {
   }
 };
 
+// A lone std::unique_ptr, see Relocation.hpp.
+static_assert(IsPointerSizedHandle<Shape>);
+
+template <>
+inline constexpr bool IsTriviallyRelocatable<Shape> = true;
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /* User Code */
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
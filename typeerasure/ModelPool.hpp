@@ -0,0 +1,278 @@
+// Per Type Object Pools.
+//
+// A scene which creates and destroys lots of short lived shapes every frame
+// spends a good part of it in `new` and `delete` for their models. A pool keeps
+// the memory of destroyed objects of one type on a freelist, so the next object
+// of that type reuses it instead of going back to the allocator.
+//
+// Memory is carved out of slabs, which are allocated on demand and only given
+// back once the pool itself goes away.
+/*
+  void* memory = TypePool<Circle, false>::allocate();
+  Circle* circle = ::new (memory) Circle{5.0};
+  std::destroy_at(circle);
+  TypePool<Circle, false>::deallocate(circle);
+*/
+
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+struct PoolStats {
+  // Allocations which reused the memory of a deallocated block.
+  std::size_t hits{0};
+  // Allocations which had to take a fresh block from a slab.
+  std::size_t misses{0};
+  std::size_t slabs{0};
+};
+
+// A freelist of blocks of `Size` bytes. Not thread safe.
+template <std::size_t Size, std::size_t Align>
+class FreeListPool {
+  union Node {
+    Node* next;
+    alignas(Align) std::byte storage[Size];
+  };
+
+  static constexpr std::size_t SlabNodes = 64;
+
+  std::vector<std::unique_ptr<Node[]>> slabs_;
+  // Deallocated blocks. Fresh blocks are bumped off the newest slab instead,
+  // so the two can be told apart in the stats.
+  Node* free_{nullptr};
+  Node* fresh_{nullptr};
+  Node* fresh_end_{nullptr};
+  PoolStats stats_;
+
+ public:
+  FreeListPool() = default;
+  FreeListPool(const FreeListPool&) = delete;
+  FreeListPool& operator=(const FreeListPool&) = delete;
+
+  void* allocate() {
+    if (free_) {
+      ++stats_.hits;
+      Node* node = free_;
+      free_ = node->next;
+      return node->storage;
+    }
+    ++stats_.misses;
+    if (fresh_ == fresh_end_) {
+      fresh_ = slabs_.emplace_back(new Node[SlabNodes]).get();
+      fresh_end_ = fresh_ + SlabNodes;
+      ++stats_.slabs;
+    }
+    return (fresh_++)->storage;
+  }
+
+  void deallocate(void* memory) noexcept {
+    Node* node = ::new (memory) Node;
+    node->next = free_;
+    free_ = node;
+  }
+
+  PoolStats stats() const { return stats_; }
+};
+
+// A pool for objects of type `T` for one thread, which never takes a lock.
+//
+// Every block remembers the pool it came from. A block freed on another thread
+// is pushed onto its owner's list of remote frees, which the owner takes over
+// the next time it allocates, so it never ends up on a freelist whose slabs
+// belong to somebody else.
+//
+// Pools are never destroyed, since blocks may outlive the thread which
+// allocated them. When a thread exits its pool is orphaned instead, and adopted
+// by the next thread which needs one, so a program creates no more pools than
+// it ever runs threads at once.
+template <class T>
+class ThreadLocalPool {
+  struct Block {
+    ThreadLocalPool* owner;
+    // Next remote free, only while the block is on `remote_`.
+    Block* next;
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+
+  FreeListPool<sizeof(Block), alignof(Block)> blocks_;
+  std::atomic<Block*> remote_{nullptr};
+
+  // Returns the pool of a thread which exits to `Orphans()`.
+  struct Owner {
+    ThreadLocalPool* pool;
+
+    Owner() : pool{Adopt()} { current_ = pool; }
+
+    ~Owner() {
+      current_ = nullptr;
+      std::lock_guard lock{OrphansMutex()};
+      Orphans().push_back(pool);
+    }
+  };
+
+  // The pool of this thread, or null once its `Owner` is gone. Trivially
+  // destructible, so it can still be read during thread exit.
+  static inline thread_local ThreadLocalPool* current_{nullptr};
+
+  static std::vector<ThreadLocalPool*>& Orphans() {
+    static std::vector<ThreadLocalPool*>& orphans =
+        *new std::vector<ThreadLocalPool*>;
+    return orphans;
+  }
+
+  static std::mutex& OrphansMutex() {
+    static std::mutex& mutex = *new std::mutex;
+    return mutex;
+  }
+
+  static ThreadLocalPool* Adopt() {
+    std::lock_guard lock{OrphansMutex()};
+    if (Orphans().empty()) return new ThreadLocalPool;
+    ThreadLocalPool* pool = Orphans().back();
+    Orphans().pop_back();
+    return pool;
+  }
+
+  static Block* BlockOf(void* memory) {
+    return reinterpret_cast<Block*>(static_cast<std::byte*>(memory) -
+                                    offsetof(Block, storage));
+  }
+
+  // Moves the blocks freed by other threads onto the freelist.
+  void reclaim() {
+    if (!remote_.load(std::memory_order_relaxed)) return;
+    Block* block = remote_.exchange(nullptr, std::memory_order_acquire);
+    while (block) {
+      Block* next = block->next;
+      blocks_.deallocate(block);
+      block = next;
+    }
+  }
+
+  void push_remote(Block* block) noexcept {
+    block->next = remote_.load(std::memory_order_relaxed);
+    while (!remote_.compare_exchange_weak(block->next, block,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+  }
+
+  ThreadLocalPool() = default;
+
+ public:
+  ThreadLocalPool(const ThreadLocalPool&) = delete;
+  ThreadLocalPool& operator=(const ThreadLocalPool&) = delete;
+
+  // The calling thread's pool.
+  static ThreadLocalPool& Current() {
+    thread_local Owner owner;
+    return *owner.pool;
+  }
+
+  void* allocate() {
+    reclaim();
+    Block* block = ::new (blocks_.allocate()) Block;
+    block->owner = this;
+    return block->storage;
+  }
+
+  // May be called on any thread, for a block of any pool.
+  static void deallocate(void* memory) noexcept {
+    Block* block = BlockOf(memory);
+    ThreadLocalPool* owner = block->owner;
+    if (owner == current_) {
+      owner->blocks_.deallocate(block);
+    } else {
+      owner->push_remote(block);
+    }
+  }
+
+  PoolStats stats() const { return blocks_.stats(); }
+};
+
+// The pool for objects of type `T`, every type gets its own.
+//
+// With `ThreadLocal` each thread has its own pool and never takes a lock, see
+// `ThreadLocalPool`. An object may be destroyed on any thread, its memory is
+// returned to the pool of the thread which allocated it. Otherwise there is
+// one pool per type, guarded by a mutex, which is never destroyed so that
+// objects with static storage duration can still return their memory during
+// shutdown.
+template <class T, bool ThreadLocal>
+class TypePool {
+  using Pool = FreeListPool<sizeof(T), alignof(T)>;
+  using LocalPool = ThreadLocalPool<T>;
+
+  static Pool& pool() {
+    static Pool& pool = *new Pool;
+    return pool;
+  }
+
+  static std::mutex& mutex() {
+    static std::mutex& mutex = *new std::mutex;
+    return mutex;
+  }
+
+ public:
+  static void* allocate() {
+    if constexpr (ThreadLocal) {
+      return LocalPool::Current().allocate();
+    } else {
+      std::lock_guard lock{mutex()};
+      return pool().allocate();
+    }
+  }
+
+  static void deallocate(void* memory) noexcept {
+    if constexpr (ThreadLocal) {
+      LocalPool::deallocate(memory);
+    } else {
+      std::lock_guard lock{mutex()};
+      pool().deallocate(memory);
+    }
+  }
+
+  // The statistics of the calling thread's pool, when `ThreadLocal`.
+  static PoolStats stats() {
+    if constexpr (ThreadLocal) {
+      return LocalPool::Current().stats();
+    } else {
+      std::lock_guard lock{mutex()};
+      return pool().stats();
+    }
+  }
+};
+
+static int ModelPoolDemo() {
+  struct Block {
+    double payload[8];
+  };
+  using Pool = TypePool<Block, true>;
+
+  // Freed on another thread, the block still goes back to this thread's pool.
+  void* memory = Pool::allocate();
+  std::thread{[&] { Pool::deallocate(memory); }}.join();
+  const PoolStats before = Pool::stats();
+  void* reused = Pool::allocate();
+  assert(reused == memory && Pool::stats().hits == before.hits + 1 &&
+         Pool::stats().misses == before.misses);
+  Pool::deallocate(reused);
+
+  // Freed after the thread which allocated it exited. Its pool lives on, and
+  // is adopted, together with the block, by the next thread.
+  std::thread{[&] { memory = Pool::allocate(); }}.join();
+  Pool::deallocate(memory);
+  std::thread{[&] {
+    reused = Pool::allocate();
+    Pool::deallocate(reused);
+  }}.join();
+  assert(reused == memory);
+
+  return 0;
+}
@@ -0,0 +1,295 @@
+// A polymorphic sequence which packs its shapes back to back into one buffer.
+//
+// `ShapeCollection` gets its speed from grouping shapes by type, which loses
+// the order they were added in. When the order matters, say for drawing,
+// `PackedShapeBuffer` keeps it: every object is placed right after the previous
+// one in a single growable byte buffer, each preceded by a pointer to the
+// dispatch table of its type. Walking the shapes in order then walks memory
+// linearly, with no pointer chasing into scattered heap models.
+//
+// An index of 32 bit offsets gives random access. Elements are handed out as
+// `ShapeView`s, so `Format`, `Calculate`, `is<T>()` and friends work just like
+// on the elements of a `std::vector<Shape>`:
+/*
+  PackedShapeBuffer shapes;
+  shapes.push_back(Circle{5.0});
+  shapes.push_back(Square{10.0});
+  for (ShapeView shape : shapes) {
+    std::cout << Format(shape);
+  }
+*/
+// Growing the buffer relocates every object to its new place, with a plain
+// `memcpy` for trivially relocatable types, so stored types must be nothrow
+// movable. Like with `std::vector`, growth invalidates references
+// and views of the elements.
+
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "AntonsSilverBullet.hpp"
+#include "Erased.hpp"
+#include "Relocation.hpp"
+
+class PackedShapeBuffer {
+  struct Table {
+    const ShapeViewDispatch* view;
+    void (*copy)(const void* from, void* to);
+    // Moves the object to `to` and destroys what is left at `from`.
+    void (*relocate)(void* from, void* to) noexcept;
+    void (*destroy)(void* object) noexcept;
+  };
+
+  template <class T>
+  static constexpr Table TableFor{
+      &ShapeDispatchModel<T>::view_table,
+      [](const void* from, void* to) {
+        if constexpr (std::is_copy_constructible_v<T>) {
+          ::new (to) T(*std::launder(static_cast<const T*>(from)));
+        } else {
+          ThrowCopyOfMoveOnly();
+        }
+      },
+      [](void* from, void* to) noexcept {
+        RelocateAt(std::launder(static_cast<T*>(from)), to);
+      },
+      [](void* object) noexcept {
+        std::destroy_at(std::launder(static_cast<T*>(object)));
+      }};
+
+  // The table pointer stored in front of every object.
+  static constexpr std::size_t HeaderSize = sizeof(const Table*);
+
+  std::unique_ptr<std::byte[]> bytes_;
+  std::size_t capacity_{0};
+  std::size_t size_{0};
+  std::vector<std::uint32_t> offsets_;
+
+  static constexpr std::size_t AlignUp(std::size_t offset, std::size_t align) {
+    return (offset + align - 1) / align * align;
+  }
+
+  const Table* table(std::size_t offset) const {
+    return *std::launder(
+        reinterpret_cast<const Table* const*>(&bytes_[offset - HeaderSize]));
+  }
+
+  void reserve_bytes(std::size_t bytes) {
+    if (bytes <= capacity_) return;
+    const std::size_t capacity = std::max({bytes, 2 * capacity_,
+                                           std::size_t{256}});
+    auto grown = std::make_unique_for_overwrite<std::byte[]>(capacity);
+    // Offsets are relative to the start of the buffer, whose alignment
+    // doesn't change, so every object keeps its offset.
+    for (std::uint32_t offset : offsets_) {
+      const Table* object_table = table(offset);
+      ::new (&grown[offset - HeaderSize]) const Table*(object_table);
+      object_table->relocate(&bytes_[offset], &grown[offset]);
+    }
+    bytes_ = std::move(grown);
+    capacity_ = capacity;
+  }
+
+ public:
+  class Iterator {
+    const PackedShapeBuffer* buffer_{nullptr};
+    std::size_t index_{0};
+
+   public:
+    using iterator_concept = std::forward_iterator_tag;
+    using iterator_category = std::input_iterator_tag;
+    using value_type = ShapeView;
+    using reference = ShapeView;
+    using difference_type = std::ptrdiff_t;
+
+    Iterator() = default;
+
+    Iterator(const PackedShapeBuffer* buffer, std::size_t index)
+        : buffer_{buffer}, index_{index} {}
+
+    ShapeView operator*() const { return (*buffer_)[index_]; }
+
+    Iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator previous = *this;
+      ++index_;
+      return previous;
+    }
+
+    friend bool operator==(const Iterator&, const Iterator&) = default;
+  };
+
+  PackedShapeBuffer() = default;
+
+  // If copying an object throws, the copies made so far are destroyed again.
+  PackedShapeBuffer(const PackedShapeBuffer& other) {
+    reserve_bytes(other.size_);
+    offsets_.reserve(other.offsets_.size());
+    try {
+      for (std::uint32_t offset : other.offsets_) {
+        const Table* object_table = other.table(offset);
+        object_table->copy(&other.bytes_[offset], &bytes_[offset]);
+        ::new (&bytes_[offset - HeaderSize]) const Table*(object_table);
+        offsets_.push_back(offset);
+      }
+    } catch (...) {
+      clear();
+      throw;
+    }
+    size_ = other.size_;
+  }
+
+  PackedShapeBuffer(PackedShapeBuffer&& other) noexcept
+      : bytes_{std::move(other.bytes_)},
+        capacity_{std::exchange(other.capacity_, 0)},
+        size_{std::exchange(other.size_, 0)},
+        offsets_{std::move(other.offsets_)} {
+    other.offsets_.clear();
+  }
+
+  PackedShapeBuffer& operator=(const PackedShapeBuffer& other) {
+    if (this != &other) {
+      PackedShapeBuffer copy{other};
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+
+  PackedShapeBuffer& operator=(PackedShapeBuffer&& other) noexcept {
+    if (this != &other) {
+      clear();
+      bytes_ = std::move(other.bytes_);
+      capacity_ = std::exchange(other.capacity_, 0);
+      size_ = std::exchange(other.size_, 0);
+      offsets_ = std::move(other.offsets_);
+      other.offsets_.clear();
+    }
+    return *this;
+  }
+
+  ~PackedShapeBuffer() { clear(); }
+
+  // Constructs a `T` from `args` at the end of the buffer. The returned
+  // reference is invalidated when the buffer grows.
+  //
+  // Throws `std::length_error` once the buffer would outgrow its 32 bit
+  // offsets, 4 GiB.
+  template <class T, class... Args>
+  T& emplace_back(Args&&... args) {
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "Over aligned shapes can't be packed.");
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+                  "Packed shapes are moved when the buffer grows.");
+    constexpr std::size_t align = std::max(alignof(T), alignof(const Table*));
+    const std::size_t offset = AlignUp(size_ + HeaderSize, align);
+    if (offset > std::numeric_limits<std::uint32_t>::max()) {
+      throw std::length_error{"Packed shape buffer too large for its offsets."};
+    }
+    reserve_bytes(offset + sizeof(T));
+    // Reserved up front, so nothing can throw once the object exists.
+    if (offsets_.size() == offsets_.capacity()) {
+      offsets_.reserve(std::max(2 * offsets_.capacity(), std::size_t{16}));
+    }
+
+    T* object = ::new (&bytes_[offset]) T(std::forward<Args>(args)...);
+    ::new (&bytes_[offset - HeaderSize]) const Table*(&TableFor<T>);
+    offsets_.push_back(static_cast<std::uint32_t>(offset));
+    size_ = offset + sizeof(T);
+    return *object;
+  }
+
+  template <class T>
+  T& push_back(T&& x) {
+    return emplace_back<std::remove_cvref_t<T>>(std::forward<T>(x));
+  }
+
+  ShapeView operator[](std::size_t index) const {
+    const std::uint32_t offset = offsets_[index];
+    return ShapeView{&bytes_[offset], table(offset)->view};
+  }
+
+  ShapeView front() const { return (*this)[0]; }
+
+  ShapeView back() const { return (*this)[offsets_.size() - 1]; }
+
+  Iterator begin() const { return Iterator{this, 0}; }
+
+  Iterator end() const { return Iterator{this, offsets_.size()}; }
+
+  std::size_t size() const { return offsets_.size(); }
+
+  bool empty() const { return offsets_.empty(); }
+
+  // Bytes of the buffer in use, including headers and padding.
+  std::size_t bytes() const { return size_; }
+
+  void reserve(std::size_t bytes) { reserve_bytes(bytes); }
+
+  void clear() {
+    for (std::uint32_t offset : offsets_) {
+      table(offset)->destroy(&bytes_[offset]);
+    }
+    offsets_.clear();
+    size_ = 0;
+  }
+};
+
+static int PackedShapeBufferDemo() {
+  PackedShapeBuffer shapes;
+  shapes.push_back(Circle{5.0});
+  shapes.push_back(Square{10.0});
+  shapes.push_back(Triangle{10.0});
+  shapes.push_back(Husky{});
+  shapes.push_back(IndirectShape<Circle>{Circle{5.0}});
+  for (int i = 0; i < 100; ++i) {
+    shapes.emplace_back<Square>(static_cast<double>(i));
+  }
+  assert(shapes.size() == 105);
+
+  // Unlike the ShapeCollection the square stays where it was added, even after
+  // the buffer grew.
+  auto square_loc =
+      std::find_if(shapes.begin(), shapes.end(),
+                   [](ShapeView shape) { return shape.is<Square>(); });
+  assert(std::distance(shapes.begin(), square_loc) == 1 && "I lost my square!");
+  assert((*square_loc).as<Square>().width() == 10.0);
+  assert(Format(shapes[0]) == Format(Shape{Circle{5.0}}));
+  assert(shapes.back().try_as<Square>()->width() == 99.0);
+
+  const PackedShapeBuffer copy{shapes};
+  assert(copy.size() == shapes.size() && copy[3].is<Husky>());
+
+  // A move only stamp can't be copied. The shapes copied before it are
+  // destroyed again, rather than leaked.
+  PackedShapeBuffer stamps;
+  stamps.push_back(Circle{5.0});
+  stamps.emplace_back<Stamp>("[#]");
+  bool thrown = false;
+  try {
+    const PackedShapeBuffer stamps_copy{stamps};
+  } catch (const std::logic_error&) {
+    thrown = true;
+  }
+  assert(thrown && stamps.size() == 2);
+
+  int results = 0;
+  for (ShapeView shape : shapes) {
+    results += Calculate(shape);
+  }
+  assert(results != 0);
+
+  return 0;
+}
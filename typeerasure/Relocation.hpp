@@ -0,0 +1,52 @@
+// Trivial Relocation.
+//
+// Relocating an object means moving it to a new address and ending the life of
+// the old one. For most types that is nothing more than copying its bytes,
+// even when its move constructor and destructor are not trivial. A Shape which
+// only holds a `std::unique_ptr` to its model is such a type: the moved from
+// pointer is null, and destroying it does nothing.
+//
+// A Shape with a small buffer is not. Its pointer may point into its own
+// buffer, and a copy of its bytes would still point into the original.
+//
+// The language can't tell that on its own yet, so a type opts in by
+// specializing `IsTriviallyRelocatable`. Containers then grow with `memcpy`
+// instead of moving and destroying every element one by one. A handle which
+// opts in proves that it's nothing but such a pointer:
+/*
+  static_assert(IsPointerSizedHandle<Shape>);
+  template <>
+  inline constexpr bool IsTriviallyRelocatable<Shape> = true;
+*/
+
+#pragma once
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <class T>
+inline constexpr bool IsTriviallyRelocatable = std::is_trivially_copyable_v<T>;
+
+// A nothrow movable handle the size of a single pointer. It has no room for a
+// buffer which that pointer could point into.
+template <class T>
+inline constexpr bool IsPointerSizedHandle =
+    std::is_nothrow_move_constructible_v<T> &&
+    std::is_nothrow_move_assignable_v<T> && sizeof(T) == sizeof(void*);
+
+// Relocates the object at `from` to the uninitialized memory at `to`.
+template <class T>
+T* RelocateAt(T* from, void* to) noexcept {
+  if constexpr (IsTriviallyRelocatable<T>) {
+    std::memcpy(to, static_cast<void*>(from), sizeof(T));
+    return std::launder(static_cast<T*>(to));
+  } else {
+    static_assert(std::is_nothrow_move_constructible_v<T>,
+                  "Relocation must not throw.");
+    T* relocated = ::new (to) T(std::move(*from));
+    std::destroy_at(from);
+    return relocated;
+  }
+}
@@ -0,0 +1,199 @@
+// Render Cache.
+//
+// Formatting a `Circle{5.0}` rasterizes the same rows every time, and a scene
+// formats the same few circles frame after frame. The render cache keeps the
+// most recently used rasters, keyed by the type of the shape and the hash of
+// its parameters, and appends a copy of the cached raster instead.
+//
+// The cache is bounded by the bytes it holds. When it's full, the least
+// recently used raster is evicted. A copy of every cached object is kept along
+// with its raster, so that a hash collision can never serve the raster of a
+// different shape.
+/*
+  RenderCache cache;
+  cache.FormatTo(out, circle, Hash(circle),
+                 [&](std::string& raster) { FormatTo(raster, circle); });
+  RenderCacheStats stats = cache.stats();
+*/
+// All members may be called concurrently. The raster of a miss is rendered
+// outside of the lock, so two threads missing the same shape may both render
+// it, but only one raster is kept.
+
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include "TypeId.hpp"
+
+struct RenderCacheStats {
+  std::size_t hits{0};
+  std::size_t misses{0};
+  std::size_t evictions{0};
+  std::size_t entries{0};
+  // The rasters, the copies of their objects and the bookkeeping of entries.
+  std::size_t bytes{0};
+  std::size_t capacity{0};
+};
+
+class RenderCache {
+  struct Entry {
+    TypeId type;
+    std::size_t hash;
+    // A copy of the rendered object, compared by `equal`.
+    std::shared_ptr<const void> object;
+    bool (*equal)(const void* cached, const void* object);
+    std::string raster;
+    std::size_t bytes;
+  };
+
+  using List = std::list<Entry>;
+
+  // Most recently used first.
+  List entries_;
+  std::unordered_multimap<std::size_t, List::iterator> index_;
+  RenderCacheStats stats_;
+  mutable std::mutex mutex_;
+
+  template <class T>
+  static bool Equal(const void* cached, const void* object) {
+    return *static_cast<const T*>(cached) == *static_cast<const T*>(object);
+  }
+
+  static std::size_t Key(TypeId type, std::size_t hash) {
+    const std::size_t seed = std::hash<TypeId>{}(type);
+    return seed ^ (hash + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+  }
+
+  template <class T>
+  List::iterator find(std::size_t key, std::size_t hash, const T& object) {
+    auto [first, last] = index_.equal_range(key);
+    for (; first != last; ++first) {
+      const Entry& entry = *first->second;
+      if (entry.type == TypeIdOf<T> && entry.hash == hash &&
+          entry.equal(entry.object.get(), &object)) {
+        return first->second;
+      }
+    }
+    return entries_.end();
+  }
+
+  void unindex(List::iterator entry) {
+    auto [first, last] = index_.equal_range(Key(entry->type, entry->hash));
+    for (; first != last; ++first) {
+      if (first->second == entry) {
+        index_.erase(first);
+        return;
+      }
+    }
+  }
+
+  // Keeps `raster` for the next call, unless another thread rendered the same
+  // object in the meantime.
+  template <class T>
+  void insert(std::size_t key, std::size_t hash, const T& object,
+              std::string&& raster) {
+    std::lock_guard lock{mutex_};
+    if (find(key, hash, object) != entries_.end()) return;
+    const std::size_t bytes = raster.size() + sizeof(T) + sizeof(Entry);
+    if (bytes > stats_.capacity) return;
+    evict_until(stats_.capacity - bytes);
+    entries_.push_front(Entry{TypeIdOf<T>, hash,
+                              std::make_shared<const T>(object), &Equal<T>,
+                              std::move(raster), bytes});
+    try {
+      index_.emplace(key, entries_.begin());
+    } catch (...) {
+      entries_.pop_front();
+      throw;
+    }
+    stats_.bytes += bytes;
+    ++stats_.entries;
+  }
+
+  void evict_until(std::size_t capacity) {
+    while (stats_.bytes > capacity && !entries_.empty()) {
+      const List::iterator oldest = std::prev(entries_.end());
+      unindex(oldest);
+      stats_.bytes -= oldest->bytes;
+      entries_.erase(oldest);
+      --stats_.entries;
+      ++stats_.evictions;
+    }
+  }
+
+ public:
+  static constexpr std::size_t DefaultCapacity = 4 << 20;
+
+  explicit RenderCache(std::size_t capacity = DefaultCapacity) {
+    stats_.capacity = capacity;
+  }
+
+  RenderCache(const RenderCache&) = delete;
+  RenderCache& operator=(const RenderCache&) = delete;
+
+  // The cache `Format` consults for types which opt in, see
+  // `ShapeRenderCacheFor`. Never destroyed.
+  static RenderCache& Global() {
+    static RenderCache& cache = *new RenderCache;
+    return cache;
+  }
+
+  // Appends the raster of `object`, whose parameters hash to `hash`, to `out`.
+  // On a miss, `render(raster)` appends it to an empty string first.
+  //
+  // Caching is best effort. If keeping the raster fails, say for lack of
+  // memory, the failure is swallowed: the raster is already in `out`, so
+  // formatting still succeeds.
+  template <class T, class Render>
+  void FormatTo(std::string& out, const T& object, std::size_t hash,
+                Render&& render) {
+    const std::size_t key = Key(TypeIdOf<T>, hash);
+    {
+      std::lock_guard lock{mutex_};
+      if (const List::iterator hit = find(key, hash, object);
+          hit != entries_.end()) {
+        entries_.splice(entries_.begin(), entries_, hit);
+        ++stats_.hits;
+        out += hit->raster;
+        return;
+      }
+      ++stats_.misses;
+    }
+
+    std::string raster;
+    render(raster);
+    out += raster;
+
+    try {
+      insert(key, hash, object, std::move(raster));
+    } catch (...) {
+    }
+  }
+
+  RenderCacheStats stats() const {
+    std::lock_guard lock{mutex_};
+    return stats_;
+  }
+
+  // Evicts as many rasters as needed to fit the new capacity.
+  void set_capacity(std::size_t capacity) {
+    std::lock_guard lock{mutex_};
+    stats_.capacity = capacity;
+    evict_until(capacity);
+  }
+
+  // Drops every raster, the counters of hits, misses and evictions are kept.
+  void clear() {
+    std::lock_guard lock{mutex_};
+    index_.clear();
+    entries_.clear();
+    stats_.entries = 0;
+    stats_.bytes = 0;
+  }
+};
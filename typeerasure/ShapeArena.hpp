@@ -0,0 +1,147 @@
+// Heap Compaction.
+//
+// Models which don't fit the small buffer of a Shape are allocated one by one.
+// After enough shapes came and went, the models of a `std::vector<Shape>` are
+// scattered all over the heap, in no relation to the order of the vector, and
+// walking the vector misses the cache on nearly every model.
+//
+// `compact` moves the model of every such shape into one freshly allocated
+// arena, laid out in the order of the shapes, and frees the old models. The
+// shapes keep their place and their values, only their models move:
+/*
+  ShapeArena arena;
+  std::vector<Shape> scene = ...;
+  ... hours of churn ...
+  arena = compact(scene);  // Once in a while, say during an idle frame.
+*/
+// The arena must outlive the shapes it holds. Copies of them don't allocate
+// from it, so they stay valid after the arena is gone. Shapes erased from the
+// scene don't give their memory back to the arena, it's only reclaimed by
+// compacting again and dropping the old arena.
+
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <span>
+#include <utility>
+#include <vector>
+#include "AntonsSilverBullet.hpp"
+
+class ShapeArena {
+  // Behind a pointer, so that the arena can be moved while shapes point at it.
+  std::unique_ptr<std::pmr::monotonic_buffer_resource> resource_;
+  std::size_t models_{0};
+  std::size_t bytes_{0};
+
+  friend ShapeArena compact(std::span<Shape> shapes);
+
+  ShapeArena(std::size_t models, std::size_t bytes)
+      : resource_{std::make_unique<std::pmr::monotonic_buffer_resource>(bytes)},
+        models_{models},
+        bytes_{bytes} {}
+
+ public:
+  ShapeArena() = default;
+
+  // Null for an empty arena.
+  std::pmr::memory_resource* resource() const { return resource_.get(); }
+
+  // Number of models moved into the arena.
+  std::size_t models() const { return models_; }
+
+  // Size of the arena, including the padding between models.
+  std::size_t bytes() const { return bytes_; }
+};
+
+// Moves the heap models of `shapes` into a new arena, in the order of
+// `shapes`, and returns the arena. Inline models stay in their shape, but
+// every shape is switched over to the new arena, so that none of them still
+// allocates from an older one once that's dropped.
+//
+// If moving an object throws, the shapes moved so far keep their models in the
+// arena, which is then leaked rather than freed underneath them.
+[[nodiscard]] inline ShapeArena compact(std::span<Shape> shapes) {
+  // Every model is placed at the next address suitably aligned for anything.
+  constexpr std::size_t align = alignof(std::max_align_t);
+  std::size_t models = 0;
+  std::size_t bytes = 0;
+  for (const Shape& shape : shapes) {
+    if (const std::size_t size = shape.HeapBytes()) {
+      ++models;
+      bytes += (size + align - 1) / align * align;
+    }
+  }
+  // Without any heap models there's no arena, the shapes go back to the heap.
+  ShapeArena arena = models ? ShapeArena{models, bytes} : ShapeArena{};
+  const Shape::allocator_type alloc{
+      models ? arena.resource() : std::pmr::new_delete_resource()};
+  try {
+    for (Shape& shape : shapes) {
+      // The object is moved into a model allocated from the arena, assigning
+      // the new Shape then frees the old model.
+      shape = Shape{std::allocator_arg, alloc, std::move(shape)};
+    }
+  } catch (...) {
+    arena.resource_.release();
+    throw;
+  }
+  return arena;
+}
+
+static int ShapeArenaDemo() {
+  // Declared before the scene, so that it is destroyed after it.
+  ShapeArena arena;
+  std::vector<Shape> scene;
+  for (int i = 0; i < 100; ++i) {
+    scene.emplace_back(Polygon{static_cast<double>(i)});
+    scene.emplace_back(Circle{static_cast<double>(i)});
+  }
+  std::shuffle(scene.begin(), scene.end(), std::mt19937{7});
+  std::vector<std::string> before{};
+  for (const Shape& shape : scene) {
+    before.push_back(Format(shape));
+  }
+
+  arena = compact(scene);
+  assert(arena.models() == 100 && arena.bytes() >= 100 * sizeof(Polygon));
+
+  // The polygons now follow each other in memory in the order of the scene,
+  // and nothing else changed.
+  const Polygon* previous = nullptr;
+  for (std::size_t i = 0; i < scene.size(); ++i) {
+    assert(Format(scene[i]) == before[i]);
+    if (const Polygon* polygon = scene[i].try_as<Polygon>()) {
+      assert(polygon > previous && "The polygons are out of order!");
+      previous = polygon;
+    }
+  }
+
+  // Compacting again moves the models into a new arena, and only then frees
+  // the old one.
+  scene.erase(scene.begin(), scene.begin() + 50);
+  arena = compact(scene);
+  assert(arena.models() < 100);
+  for (const Shape& shape : scene) {
+    assert(shape.get_allocator().resource() == arena.resource());
+  }
+
+  // A copy taken before compacting again isn't left pointing into the arena
+  // that compacting drops.
+  const Shape copy{scene.front()};
+  std::vector<Shape> copies(scene.begin(), scene.end());
+  arena = compact(scene);
+  assert(copy.get_allocator().resource() == std::pmr::new_delete_resource() &&
+         Format(copy) == Format(copies.front()));
+
+  int results = 0;
+  for (const Shape& shape : scene) {
+    results += Calculate(shape);
+  }
+  assert(results != 0);
+
+  return 0;
+}
@@ -0,0 +1,217 @@
+// A polymorphic collection which buckets shapes by their concrete type.
+//
+// A `std::vector<Shape>` scatters its models across the heap, and every
+// element costs one virtual call whose target changes from one element to the
+// next. `ShapeCollection` instead keeps one contiguous `std::vector<T>` segment
+// per concrete type. A pass over the collection then runs one loop per type, in
+// which the call is known at compile time and can be inlined.
+//
+// The price is the order of the elements: shapes are grouped by type and only
+// keep their insertion order relative to shapes of the same type.
+
+#pragma once
+#include <cassert>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include "AntonsSilverBullet.hpp"
+#include "TypeId.hpp"
+
+class ShapeCollection {
+  // The External Polymorphism Design Pattern, once per segment rather than once
+  // per shape.
+  class Segment {
+   public:
+    virtual ~Segment() {}
+    virtual TypeId type() const = 0;
+    virtual std::size_t size() const = 0;
+    virtual void FormatTo(std::string& out) const = 0;
+    virtual void Format(std::vector<std::string>& out) const = 0;
+    virtual void Calculate(std::vector<int>& out) const = 0;
+    virtual void visit(void (*visitor)(void* context, ShapeView shape),
+                       void* context) const = 0;
+  };
+
+  template <class T>
+  class SegmentModel : public Segment {
+    friend ShapeCollection;
+    std::vector<T> objects_;
+
+   public:
+    TypeId type() const override { return TypeIdOf<T>; }
+
+    std::size_t size() const override { return objects_.size(); }
+
+    void FormatTo(std::string& out) const override {
+      for (const T& object : objects_) {
+        ShapeFormatToCached(out, object);
+      }
+    }
+
+    void Format(std::vector<std::string>& out) const override {
+      for (const T& object : objects_) {
+        ShapeFormatToCached(out.emplace_back(), object);
+      }
+    }
+
+    void Calculate(std::vector<int>& out) const override {
+      for (const T& object : objects_) {
+        out.push_back(ShapeCalculate(object));
+      }
+    }
+
+    void visit(void (*visitor)(void* context, ShapeView shape),
+               void* context) const override {
+      for (const T& object : objects_) {
+        visitor(context, ShapeView{&object});
+      }
+    }
+  };
+
+  std::vector<std::unique_ptr<Segment>> segments_;
+
+  template <class T>
+  SegmentModel<T>* find() const {
+    for (const auto& segment : segments_) {
+      if (segment->type() == TypeIdOf<T>) {
+        return static_cast<SegmentModel<T>*>(segment.get());
+      }
+    }
+    return nullptr;
+  }
+
+ public:
+  // Adds a shape to the segment of its type. The returned reference is
+  // invalidated once more shapes of the same type are added.
+  template <class T, class... Args>
+  T& emplace(Args&&... args) {
+    SegmentModel<T>* segment = find<T>();
+    if (!segment) {
+      segments_.push_back(std::make_unique<SegmentModel<T>>());
+      segment = static_cast<SegmentModel<T>*>(segments_.back().get());
+    }
+    return segment->objects_.emplace_back(std::forward<Args>(args)...);
+  }
+
+  template <class T>
+  T& insert(T&& x) {
+    return emplace<std::remove_cvref_t<T>>(std::forward<T>(x));
+  }
+
+  // All shapes of type `T`, in the order they were added.
+  template <class T>
+  std::span<T> segment() {
+    SegmentModel<T>* segment = find<T>();
+    return segment ? std::span<T>{segment->objects_} : std::span<T>{};
+  }
+
+  template <class T>
+  std::span<const T> segment() const {
+    const SegmentModel<T>* segment = find<T>();
+    return segment ? std::span<const T>{segment->objects_}
+                   : std::span<const T>{};
+  }
+
+  std::size_t size() const {
+    std::size_t size = 0;
+    for (const auto& segment : segments_) {
+      size += segment->size();
+    }
+    return size;
+  }
+
+  bool empty() const { return size() == 0; }
+
+  void clear() { segments_.clear(); }
+
+  // Calls `f` with every shape of the listed types, one loop per type. The
+  // concrete type is known inside each loop, so `f` can be fully inlined.
+  template <class... Ts, class F>
+    requires(sizeof...(Ts) > 0)
+  void for_each(F&& f) const {
+    (
+        [&] {
+          for (const Ts& object : segment<Ts>()) {
+            f(object);
+          }
+        }(),
+        ...);
+  }
+
+  // Calls `f` with a view of every shape, whatever its type. Still one loop per
+  // segment, but the call to `f` can't be inlined into it.
+  template <class F>
+  void for_each(F&& f) const {
+    using Visitor = std::remove_reference_t<F>;
+    for (const auto& segment : segments_) {
+      segment->visit(
+          [](void* context, ShapeView shape) {
+            (*static_cast<Visitor*>(context))(shape);
+          },
+          const_cast<void*>(static_cast<const void*>(std::addressof(f))));
+    }
+  }
+
+  // Appends every shape to `out`, segment by segment. Like `Format` of a
+  // single shape, baked glyphs and the render cache are used.
+  void FormatTo(std::string& out) const {
+    for (const auto& segment : segments_) {
+      segment->FormatTo(out);
+    }
+  }
+
+  // The same, but every shape into a string of its own.
+  std::vector<std::string> Format() const {
+    std::vector<std::string> out;
+    out.reserve(size());
+    for (const auto& segment : segments_) {
+      segment->Format(out);
+    }
+    return out;
+  }
+
+  // Calculates every shape, segment by segment.
+  std::vector<int> Calculate() const {
+    std::vector<int> out;
+    out.reserve(size());
+    for (const auto& segment : segments_) {
+      segment->Calculate(out);
+    }
+    return out;
+  }
+};
+
+static int ShapeCollectionDemo() {
+  ShapeCollection shapes;
+  shapes.insert(Circle{5.0});
+  shapes.insert(Square{10.0});
+  shapes.insert(Circle{10.0});
+  shapes.insert(Triangle{10.0});
+  shapes.insert(Husky{});
+  assert(shapes.size() == 5 && shapes.segment<Circle>().size() == 2);
+
+  // Circles come out together, no matter where they were inserted.
+  const std::vector<int> results = shapes.Calculate();
+  assert(results.size() == shapes.size());
+
+  // One string for the whole collection holds the same as a string per shape.
+  std::string frame;
+  shapes.FormatTo(frame);
+  std::string joined;
+  for (const std::string& shape : shapes.Format()) {
+    joined += shape;
+  }
+  assert(frame == joined && frame.starts_with(Format(Shape{Circle{5.0}})));
+
+  double radii = 0.0;
+  shapes.for_each<Circle>([&](const Circle& circle) { radii += circle.radius(); });
+  assert(radii == 15.0 && "Lost a circle!");
+
+  std::size_t animals = 0;
+  shapes.for_each([&](ShapeView shape) { animals += shape.is<Husky>(); });
+  assert(animals == 1 && "Lost the husky!");
+
+  return 0;
+}
@@ -0,0 +1,227 @@
+// Columnar Geometry Kernels.
+//
+// The whole state of a `Circle`, `Square` or `Triangle` is a single `double`.
+// A `ShapeCollection` segment of them, a `std::vector<Circle>`, is therefore
+// nothing but a column of radii: one contiguous array of doubles, with no
+// handle, no vtable pointer and no padding in between.
+//
+// The kernels below run one geometric query over a whole column at once. Each
+// is a plain loop of branch free arithmetic from one array into another, which
+// the compiler turns into SIMD code by itself at `-O3` (or `/O2`), so a
+// pass over millions of shapes is bound by memory bandwidth rather than by one
+// virtual call per shape:
+/*
+  const ShapeCollection scene = ...;
+  std::vector<double> areas(scene.segment<Circle>().size());
+  AreaKernel(scene.segment<Circle>(), std::span{areas});
+*/
+// The scalar queries work on any single shape too, through a `ShapeView`.
+
+#pragma once
+#include <cassert>
+#include <cmath>
+#include <concepts>
+#include <cstddef>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "AntonsSilverBullet.hpp"
+#include "ShapeCollection.hpp"
+
+// A column of shapes must really be a column of their parameter.
+static_assert(sizeof(Circle) == sizeof(double) &&
+              sizeof(Square) == sizeof(double) &&
+              sizeof(Triangle) == sizeof(double));
+
+// Width and height of the axis aligned box around a shape.
+struct ShapeExtent {
+  double width{0.0};
+  double height{0.0};
+
+  friend constexpr bool operator==(const ShapeExtent&,
+                                   const ShapeExtent&) = default;
+};
+
+constexpr double Area(const Circle& circle) {
+  return std::numbers::pi * circle.radius() * circle.radius();
+}
+
+constexpr double Perimeter(const Circle& circle) {
+  return 2.0 * std::numbers::pi * circle.radius();
+}
+
+constexpr ShapeExtent Extent(const Circle& circle) {
+  return {2.0 * circle.radius(), 2.0 * circle.radius()};
+}
+
+constexpr double Area(const Square& square) {
+  return square.width() * square.width();
+}
+
+constexpr double Perimeter(const Square& square) {
+  return 4.0 * square.width();
+}
+
+constexpr ShapeExtent Extent(const Square& square) {
+  return {square.width(), square.width()};
+}
+
+// The isosceles triangle `Triangle::Format` draws: `size` rows high and twice
+// as wide at its base.
+constexpr double Area(const Triangle& triangle) {
+  return triangle.radius() * triangle.radius();
+}
+
+constexpr double Perimeter(const Triangle& triangle) {
+  return (2.0 + 2.0 * std::numbers::sqrt2) * triangle.radius();
+}
+
+constexpr ShapeExtent Extent(const Triangle& triangle) {
+  return {2.0 * triangle.radius(), triangle.radius()};
+}
+
+template <class T>
+concept ShapeHasGeometry = requires(const T& shape) {
+  { Area(shape) } -> std::convertible_to<double>;
+  { Perimeter(shape) } -> std::convertible_to<double>;
+  { Extent(shape) } -> std::same_as<ShapeExtent>;
+};
+
+// `out[i]` is set for `shapes[i]`, `out` must be at least as large.
+template <ShapeHasGeometry T>
+void AreaKernel(std::span<const T> shapes, std::span<double> out) {
+  assert(out.size() >= shapes.size());
+  for (std::size_t i = 0; i < shapes.size(); ++i) {
+    out[i] = Area(shapes[i]);
+  }
+}
+
+template <ShapeHasGeometry T>
+void PerimeterKernel(std::span<const T> shapes, std::span<double> out) {
+  assert(out.size() >= shapes.size());
+  for (std::size_t i = 0; i < shapes.size(); ++i) {
+    out[i] = Perimeter(shapes[i]);
+  }
+}
+
+template <ShapeHasGeometry T>
+void ExtentKernel(std::span<const T> shapes, std::span<ShapeExtent> out) {
+  assert(out.size() >= shapes.size());
+  for (std::size_t i = 0; i < shapes.size(); ++i) {
+    out[i] = Extent(shapes[i]);
+  }
+}
+
+// Works for any shape, but the call is only free of dispatch, and the loop
+// vectorized, when the type's `Calculate` can be inlined.
+template <class T>
+void CalculateKernel(std::span<const T> shapes, std::span<int> out) {
+  assert(out.size() >= shapes.size());
+  for (std::size_t i = 0; i < shapes.size(); ++i) {
+    out[i] = ShapeCalculate(shapes[i]);
+  }
+}
+
+// Runs `kernel` over the columns of circles, squares and triangles of
+// `shapes`, in that order, into one array.
+template <class Out, class Kernel>
+std::vector<Out> RunColumnKernel(const ShapeCollection& shapes,
+                                 Kernel&& kernel) {
+  const auto circles = shapes.segment<Circle>();
+  const auto squares = shapes.segment<Square>();
+  const auto triangles = shapes.segment<Triangle>();
+  std::vector<Out> out(circles.size() + squares.size() + triangles.size());
+  std::span<Out> rest{out};
+  kernel(circles, rest.first(circles.size()));
+  rest = rest.subspan(circles.size());
+  kernel(squares, rest.first(squares.size()));
+  rest = rest.subspan(squares.size());
+  kernel(triangles, rest);
+  return out;
+}
+
+inline std::vector<double> Areas(const ShapeCollection& shapes) {
+  return RunColumnKernel<double>(
+      shapes, [](auto column, std::span<double> out) {
+        AreaKernel(column, out);
+      });
+}
+
+inline std::vector<double> Perimeters(const ShapeCollection& shapes) {
+  return RunColumnKernel<double>(
+      shapes, [](auto column, std::span<double> out) {
+        PerimeterKernel(column, out);
+      });
+}
+
+inline std::vector<ShapeExtent> Extents(const ShapeCollection& shapes) {
+  return RunColumnKernel<ShapeExtent>(
+      shapes, [](auto column, std::span<ShapeExtent> out) {
+        ExtentKernel(column, out);
+      });
+}
+
+// The same queries for a single shape of any type. Empty for shapes which
+// have no geometry.
+constexpr std::optional<double> Area(ShapeView shape) {
+  if (const Circle* circle = shape.try_as<Circle>()) return Area(*circle);
+  if (const Square* square = shape.try_as<Square>()) return Area(*square);
+  if (const Triangle* triangle = shape.try_as<Triangle>()) {
+    return Area(*triangle);
+  }
+  return std::nullopt;
+}
+
+constexpr std::optional<double> Perimeter(ShapeView shape) {
+  if (const Circle* circle = shape.try_as<Circle>()) return Perimeter(*circle);
+  if (const Square* square = shape.try_as<Square>()) return Perimeter(*square);
+  if (const Triangle* triangle = shape.try_as<Triangle>()) {
+    return Perimeter(*triangle);
+  }
+  return std::nullopt;
+}
+
+constexpr std::optional<ShapeExtent> Extent(ShapeView shape) {
+  if (const Circle* circle = shape.try_as<Circle>()) return Extent(*circle);
+  if (const Square* square = shape.try_as<Square>()) return Extent(*square);
+  if (const Triangle* triangle = shape.try_as<Triangle>()) {
+    return Extent(*triangle);
+  }
+  return std::nullopt;
+}
+
+static int ShapeColumnsDemo() {
+  ShapeCollection shapes;
+  shapes.insert(Circle{1.0});
+  shapes.insert(Square{10.0});
+  shapes.insert(Triangle{4.0});
+  shapes.insert(Circle{2.0});
+  shapes.insert(Husky{});
+
+  // Circles first, then squares, then triangles. The husky has no geometry.
+  const std::vector<double> areas = Areas(shapes);
+  assert(areas.size() == 4);
+  assert(areas[0] == std::numbers::pi && areas[2] == 100.0 &&
+         areas[3] == 16.0);
+  const std::vector<ShapeExtent> extents = Extents(shapes);
+  assert((extents[1] == ShapeExtent{4.0, 4.0}) &&
+         (extents[3] == ShapeExtent{8.0, 4.0}));
+  assert(Perimeters(shapes)[2] == 40.0);
+
+  // The kernels and the views agree on every shape.
+  std::size_t i = 0;
+  shapes.for_each<Circle, Square, Triangle>([&](const auto& shape) {
+    assert(Area(ShapeView{&shape}) == areas[i]);
+    ++i;
+  });
+  assert(!Area(ShapeView{&shapes.segment<Husky>()[0]}).has_value());
+
+  const auto circles = std::as_const(shapes).segment<Circle>();
+  std::vector<int> results(circles.size());
+  CalculateKernel(circles, std::span{results});
+  assert(results[0] == Calculate(Shape{circles[0]}));
+
+  return 0;
+}
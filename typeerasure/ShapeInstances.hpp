@@ -0,0 +1,135 @@
+// Instanced Shapes.
+//
+// A scene full of identical glyphs, say a thousand `Circle{5.0}`, which only
+// differ in where they are drawn, stores and rasterizes the same circle a
+// thousand times over. `ShapeInstances` keeps one erased prototype instead,
+// formatted once, and a compact record per instance with nothing but its
+// position. Drawing an instance appends the position header and the
+// prototype's raster:
+/*
+  ShapeInstances circles{Circle{5.0}};
+  for (int i = 0; i < 1000; ++i) circles.add(i, 0);
+  circles.translate(0, 1);
+  circles.FormatTo(frame);
+*/
+// Positions are kept as two arrays, one per coordinate, so that moving all
+// instances at once is a loop the compiler vectorizes.
+
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include "AntonsSilverBullet.hpp"
+#include "ShapeSideTable.hpp"
+
+class ShapeInstances {
+  // Never handed out mutably, so the raster stays that of the prototype.
+  Shape prototype_;
+  std::string raster_;
+  std::vector<int> x_;
+  std::vector<int> y_;
+
+ public:
+  explicit ShapeInstances(Shape prototype)
+      : prototype_{std::move(prototype)}, raster_{Format(prototype_)} {}
+
+  const Shape& prototype() const { return prototype_; }
+
+  const std::string& raster() const { return raster_; }
+
+  // Adds an instance at the given position and returns its index.
+  std::size_t add(int x, int y) {
+    x_.push_back(x);
+    y_.push_back(y);
+    return x_.size() - 1;
+  }
+
+  // Removes an instance by moving the last one into its place.
+  void erase(std::size_t index) {
+    assert(index < size());
+    x_[index] = x_.back();
+    y_[index] = y_.back();
+    x_.pop_back();
+    y_.pop_back();
+  }
+
+  void reserve(std::size_t instances) {
+    x_.reserve(instances);
+    y_.reserve(instances);
+  }
+
+  // Positions of all instances, for batch updates.
+  std::span<int> x() { return x_; }
+  std::span<int> y() { return y_; }
+  std::span<const int> x() const { return x_; }
+  std::span<const int> y() const { return y_; }
+
+  // Moves every instance by the same offset.
+  void translate(int dx, int dy) {
+    for (int& x : x_) {
+      x += dx;
+    }
+    for (int& y : y_) {
+      y += dy;
+    }
+  }
+
+  ShapeMetadata placement(std::size_t index) const {
+    return ShapeMetadata{.x = x_[index], .y = y_[index]};
+  }
+
+  // Appends one instance, formatted like a shape of `ShapeBaseCRTP`.
+  void FormatTo(std::string& out, std::size_t index) const {
+    ::FormatTo(out, placement(index));
+    out += raster_;
+  }
+
+  // Appends every instance, the raster is only copied, never formatted again.
+  void FormatTo(std::string& out) const {
+    out.reserve(out.size() + size() * (raster_.size() + 16));
+    for (std::size_t i = 0; i < size(); ++i) {
+      FormatTo(out, i);
+    }
+  }
+
+  // `Calculate` of every instance, which is that of the prototype.
+  int Calculate() const { return ::Calculate(prototype_); }
+
+  std::size_t size() const { return x_.size(); }
+
+  bool empty() const { return x_.empty(); }
+};
+
+static int ShapeInstancesDemo() {
+  ShapeInstances circles{Circle{5.0}};
+  circles.reserve(1000);
+  for (int i = 0; i < 1000; ++i) {
+    circles.add(i % 40, i / 40);
+  }
+  assert(circles.size() == 1000 &&
+         circles.raster() == ShapeFormat(Circle{5.0}));
+
+  // One pass over a plain array of ints moves the whole crowd.
+  circles.translate(10, 0);
+  assert(circles.x()[0] == 10 && circles.y()[999] == 24);
+
+  std::string frame;
+  circles.FormatTo(frame);
+  std::string first;
+  circles.FormatTo(first, 0);
+  assert(first == "[X:10|Y:0]\n" + circles.raster());
+  assert(frame.starts_with(first) && frame.size() >= 1000 * first.size());
+
+  // Instances of a stateless prototype cost two ints each.
+  ShapeInstances bats{Bat{}};
+  bats.add(1, 2);
+  bats.add(3, 4);
+  bats.erase(0);
+  assert(bats.size() == 1 && bats.placement(0).x == 3);
+  assert(bats.prototype().is<Bat>() && bats.Calculate() == 0);
+
+  return 0;
+}
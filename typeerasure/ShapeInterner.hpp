@@ -0,0 +1,144 @@
+// Interning.
+//
+// A scene loader which reads a thousand `Circle{5.0}` ends up with a thousand
+// equal shapes, each with its own model. Interning keeps a single immutable
+// copy of every distinct value instead, and hands out a shared handle to it.
+// Equal values get the very same handle, so comparing or hashing handles is
+// comparing or hashing pointers, and caches further down can key on identity.
+/*
+  InternedShape a = intern(Circle{5.0});
+  InternedShape b = intern(Circle{5.0});
+  assert(a == b && &*a == &*b);
+*/
+// Only `ShapeHashable` types, which provide a `Hash` and `==`, can be interned.
+
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include "AntonsSilverBullet.hpp"
+
+class InternedShape {
+  friend class ShapeInterner;
+  friend std::hash<InternedShape>;
+
+  std::shared_ptr<const Shape> shape_;
+
+  explicit InternedShape(std::shared_ptr<const Shape> shape)
+      : shape_{std::move(shape)} {}
+
+ public:
+  const Shape& operator*() const { return *shape_; }
+  const Shape* operator->() const { return shape_.get(); }
+
+  ShapeView view() const { return ShapeView{*shape_}; }
+
+  // Identity, which for interned shapes is the same as equality.
+  friend bool operator==(const InternedShape&, const InternedShape&) = default;
+};
+
+template <>
+struct std::hash<InternedShape> {
+  std::size_t operator()(const InternedShape& shape) const noexcept {
+    return std::hash<const Shape*>{}(shape.shape_.get());
+  }
+};
+
+// A set of distinct shape values. Thread safe.
+//
+// Interned values live as long as the interner or any handle to them.
+class ShapeInterner {
+  std::unordered_multimap<std::size_t, std::shared_ptr<const Shape>> shapes_;
+  mutable std::mutex mutex_;
+
+ public:
+  // The handle of the value equal to `shape`, which is added if there's none
+  // yet. Throws `std::invalid_argument` if the shape isn't hashable.
+  InternedShape intern(Shape shape) {
+    const std::optional<std::size_t> hash = shape.hash();
+    if (!hash) {
+      throw std::invalid_argument{"Interning a shape without a Hash hook."};
+    }
+
+    std::lock_guard lock{mutex_};
+    auto [first, last] = shapes_.equal_range(*hash);
+    for (; first != last; ++first) {
+      if (first->second->equals(shape)) {
+        return InternedShape{first->second};
+      }
+    }
+    auto interned = std::make_shared<const Shape>(std::move(shape));
+    shapes_.emplace(*hash, interned);
+    return InternedShape{std::move(interned)};
+  }
+
+  template <class T>
+    requires(ShapeHashable<std::remove_cvref_t<T>>)
+  InternedShape intern(T&& value) {
+    return intern(Shape{std::forward<T>(value)});
+  }
+
+  // Number of distinct values.
+  std::size_t size() const {
+    std::lock_guard lock{mutex_};
+    return shapes_.size();
+  }
+
+  // Forgets all values. Handles which are still around stay valid, but are no
+  // longer shared with new ones.
+  void clear() {
+    std::lock_guard lock{mutex_};
+    shapes_.clear();
+  }
+};
+
+// Interns into one process wide interner, which is never destroyed.
+template <class T>
+  requires(ShapeHashable<std::remove_cvref_t<T>> ||
+           std::same_as<std::remove_cvref_t<T>, Shape>)
+InternedShape intern(T&& value) {
+  static ShapeInterner& interner = *new ShapeInterner;
+  return interner.intern(std::forward<T>(value));
+}
+
+static int ShapeInternerDemo() {
+  ShapeInterner interner;
+  const InternedShape circle = interner.intern(Circle{5.0});
+  const InternedShape same_circle = interner.intern(Shape{Circle{5.0}});
+  const InternedShape other_circle = interner.intern(Circle{6.0});
+  const InternedShape square = interner.intern(Square{5.0});
+  assert(circle == same_circle && &*circle == &*same_circle);
+  assert(circle != other_circle && circle != square);
+  assert(interner.size() == 3);
+  assert(std::hash<InternedShape>{}(circle) ==
+         std::hash<InternedShape>{}(same_circle));
+  assert(Format(circle.view()) == ShapeFormat(Circle{5.0}));
+
+  // The hooks are available on any Shape.
+  const Shape triangle{Triangle{3.0}};
+  assert(triangle.equals(Shape{Triangle{3.0}}) &&
+         !triangle.equals(Shape{Triangle{4.0}}));
+  assert(triangle.hash() == Shape{Triangle{3.0}}.hash());
+
+  // A husky has no hooks, so it can't be interned and only equals itself.
+  const Shape husky{Husky{}};
+  assert(!husky.hash() && husky.equals(husky) && !husky.equals(Shape{Husky{}}));
+  bool thrown = false;
+  try {
+    interner.intern(husky);
+  } catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  assert(thrown && interner.size() == 3);
+
+  assert(intern(Triangle{3.0}) == intern(Triangle{3.0}));
+
+  return 0;
+}
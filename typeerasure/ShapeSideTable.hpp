@@ -0,0 +1,196 @@
+// Sparse Side Tables.
+//
+// `ShapeBaseCRTP` gives every shape deriving from it a `sizex` and `sizey`,
+// and `IndirectShape<T>` adds them to any `T`, whether a shape ever uses them
+// or not. They also sit right next to the state which is actually hot, so a
+// pass which only calculates drags them through the cache too.
+//
+// A `ShapeSideTable` keeps such data apart from the shapes instead, keyed by the
+// `ShapeHandle` of a `ShapeStore`. Only shapes which were given a component
+// take up an entry, and the components are packed densely for passes which
+// only look at them:
+/*
+  ShapeStore store;
+  ShapeSideTable<ShapeMetadata> metadata;
+  ShapeHandle bat = store.insert(Bat{});
+  metadata.set(bat, ShapeMetadata{.x = 4, .y = 2});
+*/
+// The table knows nothing of the store. A component of an erased shape is
+// ignored, since its handle is stale, until it's erased or overwritten through
+// a new handle of the same slot.
+
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <limits>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include "AntonsSilverBullet.hpp"
+#include "ShapeStore.hpp"
+
+// The base metadata of a shape, the same header `ShapeBaseCRTP` formats.
+struct ShapeMetadata {
+  int x{0};
+  int y{0};
+  int sizex{0};
+  int sizey{0};
+
+  friend constexpr bool operator==(const ShapeMetadata&,
+                                   const ShapeMetadata&) = default;
+};
+
+inline void FormatTo(std::string& out, const ShapeMetadata& metadata) {
+  std::format_to(std::back_inserter(out), "[X:{}|Y:{}]\n", metadata.x,
+                 metadata.y);
+}
+
+// A sparse set: the slot of a handle indexes `sparse_`, which gives the
+// position of the component in the dense arrays.
+template <class Component>
+class ShapeSideTable {
+  static constexpr std::uint32_t None = std::numeric_limits<std::uint32_t>::max();
+
+  std::vector<std::uint32_t> sparse_;
+  std::vector<ShapeHandle> handles_;
+  std::vector<Component> components_;
+
+  // Position of the component of `handle`, or `None`. Also `None` for a
+  // component of an older shape in the same slot.
+  std::uint32_t find(ShapeHandle handle) const {
+    if (handle.index >= sparse_.size()) return None;
+    const std::uint32_t dense = sparse_[handle.index];
+    return dense != None && handles_[dense] == handle ? dense : None;
+  }
+
+ public:
+  // Gives the shape of `handle` a component, replacing any it had.
+  template <class... Args>
+  Component& emplace(ShapeHandle handle, Args&&... args) {
+    if (handle.index >= sparse_.size()) {
+      sparse_.resize(handle.index + 1, None);
+    }
+    const std::uint32_t dense = sparse_[handle.index];
+    if (dense != None) {
+      // Possibly left behind by an erased shape, which reused the slot.
+      handles_[dense] = handle;
+      return components_[dense] = Component(std::forward<Args>(args)...);
+    }
+    Component& component =
+        components_.emplace_back(std::forward<Args>(args)...);
+    handles_.push_back(handle);
+    sparse_[handle.index] = static_cast<std::uint32_t>(components_.size() - 1);
+    return component;
+  }
+
+  Component& set(ShapeHandle handle, const Component& component) {
+    return emplace(handle, component);
+  }
+
+  bool erase(ShapeHandle handle) {
+    const std::uint32_t dense = find(handle);
+    if (dense == None) return false;
+
+    const std::uint32_t last = static_cast<std::uint32_t>(handles_.size() - 1);
+    if (dense != last) {
+      handles_[dense] = handles_[last];
+      components_[dense] = std::move(components_[last]);
+      sparse_[handles_[dense].index] = dense;
+    }
+    handles_.pop_back();
+    components_.pop_back();
+    sparse_[handle.index] = None;
+    return true;
+  }
+
+  bool contains(ShapeHandle handle) const { return find(handle) != None; }
+
+  // The component, or nullptr if the shape has none.
+  Component* get(ShapeHandle handle) {
+    const std::uint32_t dense = find(handle);
+    return dense == None ? nullptr : &components_[dense];
+  }
+
+  const Component* get(ShapeHandle handle) const {
+    const std::uint32_t dense = find(handle);
+    return dense == None ? nullptr : &components_[dense];
+  }
+
+  // The component, or a default one if the shape has none.
+  Component value_or(ShapeHandle handle, Component fallback = {}) const {
+    const Component* component = get(handle);
+    return component ? *component : fallback;
+  }
+
+  // All components, and the handles of their shapes in the same order.
+  std::span<Component> components() { return components_; }
+  std::span<const Component> components() const { return components_; }
+  std::span<const ShapeHandle> handles() const { return handles_; }
+
+  std::size_t size() const { return components_.size(); }
+
+  bool empty() const { return components_.empty(); }
+
+  void clear() {
+    sparse_.clear();
+    handles_.clear();
+    components_.clear();
+  }
+};
+
+// Formats a shape of the store behind its metadata header, if it has one.
+// Returns false, and appends nothing, for a stale handle.
+inline bool FormatTo(std::string& out, const ShapeStore& store,
+                     const ShapeSideTable<ShapeMetadata>& metadata,
+                     ShapeHandle handle) {
+  const ShapeView shape{store, handle};
+  if (shape.empty()) return false;
+  if (const ShapeMetadata* header = metadata.get(handle)) {
+    FormatTo(out, *header);
+  }
+  FormatTo(out, shape);
+  return true;
+}
+
+static int ShapeSideTableDemo() {
+  ShapeStore store;
+  const ShapeHandle circle = store.insert(Circle{5.0});
+  const ShapeHandle bat = store.insert(Bat{});
+  const ShapeHandle square = store.insert(Square{10.0});
+
+  // Only the bat is placed, the other shapes have no entry at all.
+  ShapeSideTable<ShapeMetadata> metadata;
+  metadata.set(bat, ShapeMetadata{.x = 4, .y = 2});
+  assert(metadata.size() == 1 && !metadata.contains(circle));
+  assert(metadata.value_or(square) == ShapeMetadata{});
+
+  // The same header a Husky gets from its CRTP base, without the Bat carrying
+  // it around.
+  std::string out;
+  FormatTo(out, store, metadata, bat);
+  assert(out.starts_with("[X:4|Y:2]\n") && out.ends_with(Format(Bat{})));
+
+  // Moving every placed shape is one pass over a dense array of components.
+  metadata.set(square, ShapeMetadata{.x = 1, .y = 1, .sizex = 10, .sizey = 10});
+  for (ShapeMetadata& placement : metadata.components()) {
+    ++placement.x;
+  }
+  assert(metadata.get(bat)->x == 5 && metadata.get(square)->x == 2);
+
+  // A shape which reuses the slot of an erased one doesn't inherit its
+  // metadata.
+  store.erase(bat);
+  const ShapeHandle reused = store.insert(Triangle{10.0});
+  assert(reused.index == bat.index && !metadata.contains(reused));
+  metadata.set(reused, ShapeMetadata{.x = 7});
+  assert(!metadata.contains(bat) && metadata.get(reused)->x == 7);
+  const std::size_t formatted = out.size();
+  assert(!FormatTo(out, store, metadata, bat) && out.size() == formatted);
+  assert(metadata.erase(square) && metadata.size() == 1);
+
+  return 0;
+}
@@ -0,0 +1,201 @@
+// A slot map of shapes, referenced through generational handles.
+//
+// A `ShapeView` or a pointer into a `std::vector<Shape>` dangles as soon as the
+// vector grows. `ShapeStore` hands out a `ShapeHandle` for every shape instead:
+// an index into a table of slots, and the generation of the slot at the time
+// the shape was added. The slot knows where its shape currently lives, so the
+// handle stays valid however the shapes move around. Erasing a shape bumps the
+// generation of its slot, so old handles to it are detected as stale rather
+// than silently referring to whatever shape reuses the slot.
+//
+// - Insert and erase are O(1), erasing moves the last shape into the gap.
+// - The shapes themselves are kept densely in one vector, iteration is as fast
+//   as over a `std::vector<Shape>`, in no particular order.
+/*
+  ShapeStore store;
+  ShapeHandle husky = store.insert(Husky{});
+  ... add as many shapes as you like ...
+  std::cout << Format(ShapeView{store, husky});
+*/
+
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#include "AntonsSilverBullet.hpp"
+
+struct ShapeHandle {
+  std::uint32_t index{std::numeric_limits<std::uint32_t>::max()};
+  std::uint32_t generation{0};
+
+  friend constexpr bool operator==(ShapeHandle lhs, ShapeHandle rhs) = default;
+};
+
+class ShapeStore {
+  static constexpr std::uint32_t None = std::numeric_limits<std::uint32_t>::max();
+
+  struct Slot {
+    // Position of the shape in `shapes_`, or the next free slot once erased.
+    std::uint32_t dense{None};
+    std::uint32_t generation{0};
+  };
+
+  std::vector<Shape> shapes_;
+  // The slot of every shape in `shapes_`, to fix it up when the shape moves.
+  std::vector<std::uint32_t> slot_of_;
+  std::vector<Slot> slots_;
+  // Head of the list of free slots.
+  std::uint32_t free_{None};
+
+  template <class... Args>
+  ShapeHandle add(Args&&... args) {
+    if (free_ == None) {
+      free_ = static_cast<std::uint32_t>(slots_.size());
+      slots_.emplace_back();
+    }
+    slot_of_.push_back(free_);
+    try {
+      shapes_.emplace_back(std::forward<Args>(args)...);
+    } catch (...) {
+      slot_of_.pop_back();
+      throw;
+    }
+
+    const std::uint32_t index = free_;
+    Slot& slot = slots_[index];
+    free_ = slot.dense;
+    slot.dense = static_cast<std::uint32_t>(shapes_.size() - 1);
+    return ShapeHandle{index, slot.generation};
+  }
+
+ public:
+  // Adds a `T` constructed from `args`.
+  template <class T, class... Args>
+  ShapeHandle emplace(Args&&... args) {
+    return add(std::in_place_type<T>, std::forward<Args>(args)...);
+  }
+
+  // Adds a shape, or anything a shape can be made of.
+  template <class T>
+  ShapeHandle insert(T&& x) {
+    return add(std::forward<T>(x));
+  }
+
+  // Removes the shape, if the handle is not stale already. Handles of all
+  // other shapes stay valid.
+  bool erase(ShapeHandle handle) {
+    if (!contains(handle)) return false;
+
+    Slot& slot = slots_[handle.index];
+    const std::uint32_t last = static_cast<std::uint32_t>(shapes_.size() - 1);
+    if (slot.dense != last) {
+      shapes_[slot.dense] = std::move(shapes_[last]);
+      slot_of_[slot.dense] = slot_of_[last];
+      slots_[slot_of_[last]].dense = slot.dense;
+    }
+    shapes_.pop_back();
+    slot_of_.pop_back();
+
+    ++slot.generation;
+    slot.dense = free_;
+    free_ = handle.index;
+    return true;
+  }
+
+  // False once the shape was erased, even if its slot was reused since.
+  bool contains(ShapeHandle handle) const {
+    return handle.index < slots_.size() &&
+           slots_[handle.index].generation == handle.generation;
+  }
+
+  // The shape, or nullptr for a stale handle.
+  Shape* get(ShapeHandle handle) {
+    return contains(handle) ? &shapes_[slots_[handle.index].dense] : nullptr;
+  }
+
+  const Shape* get(ShapeHandle handle) const {
+    return contains(handle) ? &shapes_[slots_[handle.index].dense] : nullptr;
+  }
+
+  Shape& operator[](ShapeHandle handle) {
+    assert(contains(handle) && "Stale shape handle!");
+    return shapes_[slots_[handle.index].dense];
+  }
+
+  const Shape& operator[](ShapeHandle handle) const {
+    assert(contains(handle) && "Stale shape handle!");
+    return shapes_[slots_[handle.index].dense];
+  }
+
+  // The handle of the shape at `position` in iteration order.
+  ShapeHandle handle(std::size_t position) const {
+    const std::uint32_t index = slot_of_[position];
+    return ShapeHandle{index, slots_[index].generation};
+  }
+
+  auto begin() { return shapes_.begin(); }
+  auto end() { return shapes_.end(); }
+  auto begin() const { return shapes_.begin(); }
+  auto end() const { return shapes_.end(); }
+
+  std::size_t size() const { return shapes_.size(); }
+
+  bool empty() const { return shapes_.empty(); }
+};
+
+// Like any view of a shape, it's invalidated when the store changes. Keep the
+// handle around and make a new view from it instead. Unlike `store[handle]`,
+// a stale handle is checked in release builds as well, and gives an empty view.
+inline ShapeView::ShapeView(const ShapeStore& store, ShapeHandle handle)
+    : ShapeView{nullptr, nullptr} {
+  if (const Shape* shape = store.get(handle)) {
+    *this = ShapeView{*shape};
+  }
+}
+
+static int ShapeStoreDemo() {
+  ShapeStore store;
+  store.insert(Circle{5.0});
+  const ShapeHandle square = store.emplace<Square>(10.0);
+  const ShapeHandle husky = store.insert(Husky{});
+  const ShapeHandle bat = store.insert(Shape{Bat{}});
+
+  std::vector<ShapeHandle> animals{};
+  for (std::size_t i = 0; i < store.size(); ++i) {
+    const ShapeView shape{store, store.handle(i)};
+    if (shape.is<Husky>() || shape.is<Bat>()) animals.push_back(store.handle(i));
+  }
+
+  // Plenty of new shapes, the store grows many times over. Unlike pointers
+  // into a vector, the handles don't care.
+  for (int i = 0; i < 1000; ++i) {
+    store.insert(Triangle{static_cast<double>(i % 10)});
+  }
+  for (ShapeHandle animal : animals) {
+    assert(store.contains(animal) && "I lost an animal!");
+    const ShapeView view{store, animal};
+    assert(view.is<Husky>() || view.is<Bat>());
+  }
+
+  // The square is gone, its handle is detected as stale even after its slot
+  // was reused. The rest are unaffected.
+  assert(store.erase(square) && !store.erase(square));
+  const ShapeHandle reused = store.insert(Square{4.0});
+  assert(reused.index == square.index && reused != square);
+  assert(!store.contains(square) && store.get(square) == nullptr);
+  assert(ShapeView(store, square).empty());
+  assert(store[husky].is<Husky>() && store[bat].is<Bat>());
+  assert(store[reused].as<Square>().width() == 4.0);
+  assert(store.size() == 1004);
+
+  int results = 0;
+  for (const Shape& shape : store) {
+    results += Calculate(shape);
+  }
+  assert(results != 0);
+
+  return 0;
+}
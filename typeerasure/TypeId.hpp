@@ -0,0 +1,80 @@
+// Compile Time Type Identifiers.
+//
+// `typeid(T)` needs RTTI, and comparing two `std::type_info` objects may end up
+// comparing their mangled names, depending on the ABI. Checking the type of
+// every erased shape in a filter pays for that on every element.
+//
+// `TypeId` is the address of a variable which exists once per type instead.
+// It can be created and compared in a constant expression, is as cheap to
+// compare as a pointer, and works with `-fno-rtti`.
+/*
+  static_assert(TypeIdOf<Circle> != TypeIdOf<Square>);
+  static_assert(TypeIdOf<const Circle> == TypeIdOf<Circle>);
+*/
+
+#pragma once
+#include <compare>
+#include <functional>
+#include <type_traits>
+#include <typeinfo>
+
+// 1 when the translation unit is compiled with RTTI, otherwise 0.
+#ifndef TYPE_ID_HAS_RTTI
+#if defined(__cpp_rtti) || defined(__GXX_RTTI) || defined(_CPPRTTI)
+#define TYPE_ID_HAS_RTTI 1
+#else
+#define TYPE_ID_HAS_RTTI 0
+#endif
+#endif
+
+class TypeId {
+  // Not const: the linker may fold identical read only constants into one
+  // (MSVC's /OPT:ICF, gold's --icf=all), which would give every type the same
+  // id. Writable variables are never folded.
+  template <class T>
+  struct Tag {
+    static inline char id{};
+  };
+
+  const void* id_{nullptr};
+
+  constexpr explicit TypeId(const void* id) : id_{id} {}
+
+ public:
+  constexpr TypeId() = default;
+
+  template <class T>
+  static constexpr TypeId Of() {
+    return TypeId{&Tag<std::remove_cv_t<T>>::id};
+  }
+
+  friend constexpr bool operator==(TypeId lhs, TypeId rhs) = default;
+
+  // An arbitrary, but consistent, order. Not usable in constant expressions.
+  friend std::strong_ordering operator<=>(TypeId lhs, TypeId rhs) {
+    return std::compare_three_way{}(lhs.id_, rhs.id_);
+  }
+
+  friend std::hash<TypeId>;
+};
+
+template <>
+struct std::hash<TypeId> {
+  std::size_t operator()(TypeId type) const noexcept {
+    return std::hash<const void*>{}(type.id_);
+  }
+};
+
+template <class T>
+inline constexpr TypeId TypeIdOf = TypeId::Of<T>();
+
+// `&typeid(T)` with RTTI, otherwise `nullptr`. Lets dispatch tables keep a
+// `std::type_info` for diagnostics without requiring RTTI.
+template <class T>
+constexpr const std::type_info* TypeInfoOf() {
+#if TYPE_ID_HAS_RTTI
+  return &typeid(T);
+#else
+  return nullptr;
+#endif
+}
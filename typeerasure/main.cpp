@@ -6,12 +6,44 @@
 #include <memory>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <vector>
 #include "AntonsSilverBullet.hpp"
+#include "Benchmark.hpp"
+#include "PackedShapeBuffer.hpp"
+#include "ShapeArena.hpp"
+#include "ShapeCollection.hpp"
+#include "ShapeColumns.hpp"
+#include "ShapeInstances.hpp"
+#include "ShapeInterner.hpp"
+#include "ShapeSideTable.hpp"
+#include "ShapeStore.hpp"
 
-int main() {
+int main(int argc, char** argv) {
+  if (argc > 1 && std::string_view{argv[1]} == "--bench") {
+    return ShapeBenchmarks();
+  }
+
+  if (TypeIdDemo() != 0) {
+    return 1;
+  }
   AntonsSilverBullet();
+  ShapeMemoryDemo();
+  ShapeEmplaceDemo();
+  ShapeGlyphDemo();
+  RenderCacheDemo();
+  ShapeFormatToDemo();
+  ErasedShapeDemo();
+  ModelPoolDemo();
+  ShapeCollectionDemo();
+  PackedShapeBufferDemo();
+  ShapeStoreDemo();
+  ShapeArenaDemo();
+  ShapeSideTableDemo();
+  ShapeColumnsDemo();
+  ShapeInstancesDemo();
+  ShapeInternerDemo();
    
   return 0;
 }
\ No newline at end of file